@@ -42,6 +42,20 @@ For an overview, take a look at the namespace page @ref h5cpp.
 #include <assert.h>
 #include <vector>
 #include <iterator>
+#include <map>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <system_error>
+#include <stdint.h>
+#include <stddef.h> // offsetof
 
 #if (defined __APPLE__)
       // implement nice exception messages that need string manipulation
@@ -58,6 +72,22 @@ For an overview, take a look at the namespace page @ref h5cpp.
   #include <boost/optional.hpp>
 #endif
 
+#ifdef HDF_WRAPPER_HAS_ZLIB
+  #include <zlib.h> // for deflating and inflating chunks outside of the hdf5 library
+#endif
+
+#if (defined __unix__ || defined __APPLE__) && !defined HDF_WRAPPER_NO_MMAP
+  #define HDF_WRAPPER_HAS_MMAP
+  #include <sys/mman.h> // for memory mapped views of datasets
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+// the size of chunks chosen by Dataset::create_creation_properties, see plan_chunk_dims
+#ifndef HDF_WRAPPER_CHUNK_TARGET_BYTES
+  #define HDF_WRAPPER_CHUNK_TARGET_BYTES (256u<<10)
+#endif
+
 /** 
  * @brief Things are in here.
 */
@@ -72,6 +102,13 @@ class Attributes;
 class Attribute;
 class File;
 class Group;
+class AttributeBatch;
+class AttributeValues;
+template<class T> class MappedArray;
+template<class T> class ReadPlan;
+template<class T> class WritePlan;
+template<class T> class AppendWriter;
+template<class T> class BlockReader;
 
 
 namespace internal
@@ -80,8 +117,51 @@ struct TagOpen {};
 struct TagCreate {};
 struct IncRC {};
 struct NoIncRC {};
+
+/*
+  The HDF5 library must not be entered concurrently unless it was built thread safe.
+  Threads started by this wrapper, e.g. by the parallel chunk I/O functions,
+  hold this lock while they call into the library. See also LibraryLock.
+*/
+inline std::recursive_mutex& library_mutex()
+{
+  static std::recursive_mutex m;
+  return m;
+}
+
+typedef std::lock_guard<std::recursive_mutex> LibraryLockGuard;
+}
+
+/*
+  Concurrency model:
+  The HDF5 library can only be used by several threads at once if it was built thread safe
+  (--enable-threadsafe), which serializes all api calls internally. With such a build, threads may use
+  this wrapper concurrently, provided that the types they use are registered before the threads
+  start (see init_type_registry) and that a wrapper object is not modified by one thread while
+  others use it. Automatic error reporting and the error stack are per thread.
+  Without a thread safe build, all calls into the library, including those through this wrapper,
+  must be serialized by holding a LibraryLock. The worker threads of the parallel chunk I/O
+  functions take the same lock, so they cooperate with such programs.
+*/
+inline bool is_library_threadsafe()
+{
+  hbool_t ts = false;
+  if (H5is_library_threadsafe(&ts) < 0)
+    return false;
+  return ts > 0;
 }
 
+/*
+  Holds the global lock that serializes calls into a library which is not thread safe.
+  The lock is recursive, so it can be held around sequences of wrapper calls.
+*/
+class LibraryLock
+{
+    internal::LibraryLockGuard guard;
+  public:
+    LibraryLock() : guard(internal::library_mutex()) {}
+};
+
 static void disableAutoErrorReporting()
 {
   H5Eset_auto(H5E_DEFAULT, NULL, NULL);
@@ -153,23 +233,120 @@ static herr_t custom_print_cb(unsigned n, const H5E_error2_t *err_desc, void* cl
 
 } // namespace internal
 
+namespace internal
+{
+// a copy of an error stack, which is closed together with the last reference
+struct ErrorStack
+{
+  hid_t id;
+  explicit ErrorStack(hid_t id_) : id(id_) {}
+  ~ErrorStack() { H5Eclose_stack(id); }
+};
+}
+
+/*
+  The error stack of the library is captured when the exception is created, but it is only
+  formatted into the message when what() is called. Exceptions which are caught and handled
+  therefore cost little more than a copy of the stack.
+*/
 class Exception : public std::exception
 {
     std::string msg;
+    std::shared_ptr<internal::ErrorStack> stack;
+    mutable std::string formatted; // msg with the error stack, once what() was called
   public:
     Exception(const std::string &msg_) : msg(msg_)
     {
 #if (defined __APPLE__)
       // implement nice exception messages that need string manipulation
 #elif (defined _MSC_VER) || (defined __GNUG__)
-      msg.append(". Error Stack:");
-      H5Ewalk2(H5E_DEFAULT, H5E_WALK_DOWNWARD, &internal::custom_print_cb, &msg);
+      if (H5Eget_num(H5E_DEFAULT) > 0)
+      {
+        hid_t stack_id = H5Eget_current_stack(); // also clears the stack of this thread
+        if (stack_id >= 0)
+          stack = std::make_shared<internal::ErrorStack>(stack_id);
+      }
 #endif
     }
     Exception() : msg("Unspecified error") { assert(false); }
     ~Exception() throw() {}
-    const char* what() const throw() { return msg.c_str(); }
+
+    const char* what() const throw()
+    {
+      if (!stack)
+        return msg.c_str();
+      if (formatted.empty())
+      {
+        try
+        {
+          std::string tmp = msg + ". Error Stack:";
+          H5Ewalk2(stack->id, H5E_WALK_DOWNWARD, &internal::custom_print_cb, &tmp);
+          formatted.swap(tmp);
+        }
+        catch (...)
+        {
+          return msg.c_str();
+        }
+      }
+      return formatted.c_str();
+    }
+
+    // the message without the error stack
+    const std::string& get_message() const { return msg; }
+};
+
+
+/*
+  Error codes of the non-throwing variants of some functions, which take a std::error_code
+  argument. These are meant for code that probes often, e.g. for opening or creating objects.
+*/
+enum ErrorCode
+{
+  ERROR_NONE = 0,
+  ERROR_NOT_FOUND = 1,  // there is no object of this name
+  ERROR_LIBRARY = 2     // a call into the library failed
+};
+
+namespace internal
+{
+class ErrorCategory : public std::error_category
+{
+  public:
+    const char* name() const throw() { return "h5cpp"; }
+    std::string message(int ev) const
+    {
+      switch (ev)
+      {
+        case ERROR_NONE: return "success";
+        case ERROR_NOT_FOUND: return "object not found";
+        case ERROR_LIBRARY: return "error in hdf5 library call";
+        default: return "unknown error";
+      }
+    }
 };
+}
+
+inline const std::error_category& error_category()
+{
+  static internal::ErrorCategory category;
+  return category;
+}
+
+inline std::error_code make_error_code(ErrorCode e)
+{
+  return std::error_code(int(e), error_category());
+}
+
+} // namespace h5cpp
+
+namespace std
+{
+template<>
+struct is_error_code_enum<h5cpp::ErrorCode> : true_type {};
+}
+
+namespace h5cpp
+{
 
 class NameLookupError : public Exception
 {
@@ -186,6 +363,12 @@ inline Datatype get_disktype();
 template<class T>
 inline Datatype get_memtype();
 
+namespace internal
+{
+template<class T>
+struct TypeRegistry;
+}
+
 
 class Object
 {
@@ -202,6 +385,15 @@ class Object
       inc_ref();
     }
 
+    /*
+      Moving transfers the reference without calling into the library. The derived classes
+      get their move constructors and assignments implicitly.
+    */
+    Object(Object &&o) throw() : id(o.id)
+    {
+      o.id = -1;
+    }
+
     virtual ~Object() 
     {
       dec_ref();
@@ -210,11 +402,25 @@ class Object
     Object& operator=(const Object &o)
     {
       if (id == o.id) return *this;
-      this->~Object();
+      dec_ref(); // not this->~Object(), which would also destroy members of derived classes
       id = o.id;
       inc_ref();
       return *this;
     }
+
+    Object& operator=(Object &&o)
+    {
+      if (this == &o) return *this;
+      if (id == o.id)
+        o.dec_ref(); // we already hold a reference of our own
+      else
+      {
+        dec_ref();
+        id = o.id;
+        o.id = -1;
+      }
+      return *this;
+    }
   
     hid_t get_id() const
     {
@@ -234,6 +440,9 @@ class Object
       check_valid_throw();
       inc_ref();
     }
+
+    // takes over a handle which the library just returned, so there is no need to check it
+    Object(hid_t id, internal::NoIncRC) : id(id) {}
     
     std::string get_name() const
     {
@@ -285,10 +494,9 @@ class Object
     {
       if (id < 0) return;
       int r = H5Idec_ref(id);
+      id = -1; // our reference is gone, even if others keep the object alive
       if (r < 0)
         throw Exception("error dec ref count");
-      if (H5Iis_valid(id) > 0)
-        id = -1;
     }
 
     int get_ref()
@@ -314,6 +522,7 @@ class Datatype : public Object
   public: 
     Datatype(hid_t id) : Object(id) {}
     Datatype(hid_t id, internal::IncRC) : Object(id, internal::IncRC()) {}
+    Datatype(hid_t id, internal::NoIncRC) : Object(id, internal::NoIncRC()) {}
     Datatype() : Object() {}
 
     static Datatype copy(hid_t id)
@@ -321,7 +530,7 @@ class Datatype : public Object
       hid_t newid = H5Tcopy(id);
       if (newid < 0)
         throw Exception("error copying datatype");
-      return Datatype(newid);
+      return Datatype(newid, internal::NoIncRC());
     }
 
     static Datatype createArray(const Datatype &base, int ndims, int *dims)
@@ -331,7 +540,7 @@ class Datatype : public Object
       hid_t id = H5Tarray_create2(base.get_id(), ndims, hdims);
       if (id < 0)
         throw Exception("error creating array data type");
-      return Datatype(id);
+      return Datatype(id, internal::NoIncRC());
     }
     
     void set_size(size_t s) 
@@ -342,8 +551,93 @@ class Datatype : public Object
     }
 
     void set_variable_size() { set_size(H5T_VARIABLE); }
+
+    /*
+      String of fixed width in bytes, as opposed to the variable length strings
+      which std::string and char* are mapped to. Strings shorter than width are padded.
+    */
+    static Datatype fixed_string(size_t width, H5T_str_t pad = H5T_STR_NULLPAD)
+    {
+      Datatype dt = Datatype::copy(H5T_C_S1);
+      dt.set_size(width);
+      dt.set_strpad(pad);
+      return dt;
+    }
+
+    void set_strpad(H5T_str_t pad)
+    {
+      herr_t err = H5Tset_strpad(this->id, pad);
+      if (err < 0)
+        throw Exception("cannot set string padding");
+    }
+
+    H5T_class_t get_class() const
+    {
+      H5T_class_t c = H5Tget_class(this->id);
+      if (c == H5T_NO_CLASS)
+        throw Exception("cannot get datatype class");
+      return c;
+    }
+
+    bool is_fixed_string() const
+    {
+      return get_class() == H5T_STRING && !is_variable_length();
+    }
+
+    // number of members of a compound type
+    int get_nmembers() const
+    {
+      int n = H5Tget_nmembers(this->id);
+      if (n < 0)
+        throw Exception("cannot get number of members of datatype");
+      return n;
+    }
+
+    // index of a compound member, or -1 if there is no member of this name
+    int get_member_index(const std::string &name) const
+    {
+      AutoErrorReportingGuard guard;
+      guard.disableReporting();
+      return H5Tget_member_index(this->id, name.c_str());
+    }
+
+    std::string get_member_name(int idx) const
+    {
+      char *name = H5Tget_member_name(this->id, (unsigned int)idx);
+      if (name == NULL)
+        throw Exception("cannot get name of compound member");
+      std::string res(name);
+      H5free_memory(name);
+      return res;
+    }
+
+    Datatype get_member_type(int idx) const
+    {
+      hid_t type_id = H5Tget_member_type(this->id, (unsigned int)idx);
+      if (type_id < 0)
+        throw Exception("cannot get type of compound member");
+      return Datatype(type_id, internal::NoIncRC());
+    }
+
+    // true if the library can convert data of this type to the other type
+    bool is_convertible_to(const Datatype &other) const
+    {
+      AutoErrorReportingGuard guard;
+      guard.disableReporting();
+      H5T_cdata_t *pcdata;
+      return H5Tfind(this->id, other.get_id(), &pcdata) != NULL;
+    }
+
+    // the corresponding type of the machine, e.g. to read data of an unknown type
+    Datatype get_native() const
+    {
+      hid_t native_id = H5Tget_native_type(this->id, H5T_DIR_DEFAULT);
+      if (native_id < 0)
+        throw Exception("cannot get native datatype");
+      return Datatype(native_id, internal::NoIncRC());
+    }
     
-    size_t get_size()  // in bytes
+    size_t get_size() const  // in bytes
     {
       size_t s = H5Tget_size(this->id);
       if (s == 0)
@@ -359,6 +653,16 @@ class Datatype : public Object
       return res != 0;
     }
 
+    // true for variable length strings and types containing variable length sequences
+    bool is_variable_length() const
+    {
+      htri_t str = H5Tis_variable_str(id);
+      htri_t vlen = H5Tdetect_class(id, H5T_VLEN);
+      if (str < 0 || vlen < 0)
+        throw Exception("cannot determine if datatype has variable length");
+      return str > 0 || vlen > 0;
+    }
+
     void lock()
     {
       herr_t err = H5Tlock(get_id());
@@ -381,21 +685,27 @@ class RW
     virtual ~RW() {}
 };
 
+// errors are reported through ec if it is given, otherwise by exceptions
 class RWdataset : public RW
 {
-  hid_t ds_id, mem_type_id, mem_space_id, file_space_id;
+  hid_t ds_id, mem_type_id, mem_space_id, file_space_id, xfer_plist_id;
+  std::error_code *ec;
 public:
-  RWdataset(hid_t ds_id_, hid_t mem_type_id_, hid_t mem_space_id_, hid_t file_space_id_) : ds_id(ds_id_), mem_type_id(mem_type_id_), mem_space_id(mem_space_id_), file_space_id(file_space_id_) {}
+  RWdataset(hid_t ds_id_, hid_t mem_type_id_, hid_t mem_space_id_, hid_t file_space_id_, hid_t xfer_plist_id_ = H5P_DEFAULT, std::error_code *ec_ = NULL) : ds_id(ds_id_), mem_type_id(mem_type_id_), mem_space_id(mem_space_id_), file_space_id(file_space_id_), xfer_plist_id(xfer_plist_id_), ec(ec_) {}
   void write(const void* buf)
   {
-    herr_t err = H5Dwrite(ds_id, mem_type_id, mem_space_id, file_space_id, H5P_DEFAULT, buf);
-    if (err < 0)
+    herr_t err = H5Dwrite(ds_id, mem_type_id, mem_space_id, file_space_id, xfer_plist_id, buf);
+    if (err < 0 && ec)
+      *ec = make_error_code(ERROR_LIBRARY);
+    else if (err < 0)
       throw Exception("error writing to dataset");
   }
   void read(void *buf)
   {
-    herr_t err = H5Dread(ds_id, mem_type_id, mem_space_id, file_space_id, H5P_DEFAULT, buf);
-    if (err < 0)
+    herr_t err = H5Dread(ds_id, mem_type_id, mem_space_id, file_space_id, xfer_plist_id, buf);
+    if (err < 0 && ec)
+      *ec = make_error_code(ERROR_LIBRARY);
+    else if (err < 0)
       throw Exception("error reading from dataset");
   }
 };
@@ -404,19 +714,24 @@ public:
 class RWattribute : public RW
 {
   hid_t attr_id, mem_type_id;
+  std::error_code *ec;
 public:
-  RWattribute(hid_t attr_id_, hid_t mem_type_id_) : attr_id(attr_id_), mem_type_id(mem_type_id_) {}
+  RWattribute(hid_t attr_id_, hid_t mem_type_id_, std::error_code *ec_ = NULL) : attr_id(attr_id_), mem_type_id(mem_type_id_), ec(ec_) {}
 
   void write(const void* buf)
   {
     herr_t err = H5Awrite(attr_id, mem_type_id, buf);
-    if (err < 0)
+    if (err < 0 && ec)
+      *ec = make_error_code(ERROR_LIBRARY);
+    else if (err < 0)
       throw Exception("error writing to attribute");
   }
   void read(void *buf)
   {
     herr_t err = H5Aread(attr_id, mem_type_id, buf);
-    if (err < 0)
+    if (err < 0 && ec)
+      *ec = make_error_code(ERROR_LIBRARY);
+    else if (err < 0)
       throw Exception("error reading from attribute");
   }
 };
@@ -433,7 +748,7 @@ class Dataspace : public Object
     friend class Attributes;
     friend class Attribute;
   private:
-    Dataspace(hid_t id, internal::NoIncRC) : Object(id) {}
+    Dataspace(hid_t id, internal::NoIncRC) : Object(id, internal::NoIncRC()) {}
     Dataspace(hid_t id, internal::IncRC) : Object(id, internal::IncRC()) {}
   public:
     Dataspace() : Object() {}
@@ -444,9 +759,20 @@ class Dataspace : public Object
         this->id = -1;
     }
 
-    static Dataspace simple(int rank, const hsize_t* dims)
+    // needed because of the user declared destructor
+    Dataspace(const Dataspace &) = default;
+    Dataspace(Dataspace &&) = default;
+    Dataspace& operator=(const Dataspace &) = default;
+    Dataspace& operator=(Dataspace &&) = default;
+
+    /*
+      maxdims may be NULL, in which case the maximal dimensions equal dims. Entries of
+      maxdims can be H5S_UNLIMITED to make the dataset extensible along this dimension.
+      Extensible datasets require chunking, see Dataset::create_creation_properties.
+    */
+    static Dataspace simple(int rank, const hsize_t* dims, const hsize_t* maxdims = NULL)
     {
-      hid_t id = H5Screate_simple(rank, dims, NULL);
+      hid_t id = H5Screate_simple(rank, dims, maxdims);
       if (id < 0)
       {
         std::ostringstream oss;
@@ -458,6 +784,19 @@ class Dataspace : public Object
       return Dataspace(id, internal::NoIncRC());
     }
     
+    /*
+      Dataspace with an unlimited first (i.e. slowest varying) dimension. The other dimensions
+      are fixed. Typically used with dims[0] = 0 for datasets which grow by appending records,
+      see AppendWriter.
+    */
+    static Dataspace simple_unlimited(int rank, const hsize_t* dims)
+    {
+      hsize_t maxdims[H5S_MAX_RANK];
+      for (int i = 0; i < rank; ++i) maxdims[i] = dims[i];
+      if (rank > 0) maxdims[0] = H5S_UNLIMITED;
+      return Dataspace::simple(rank, dims, maxdims);
+    }
+
     static Dataspace scalar() 
     {
       hid_t id = H5Screate(H5S_SCALAR);
@@ -507,6 +846,24 @@ class Dataspace : public Object
         throw Exception("unable to get dataspace dimensions");
       return r;
     }
+
+    int get_dims(hsize_t *dims, hsize_t *maxdims) const
+    {
+      int r = H5Sget_simple_extent_dims(this->id, dims, maxdims);
+      if (r < 0)
+        throw Exception("unable to get dataspace dimensions");
+      return r;
+    }
+
+    // true if any of the maximal dimensions is H5S_UNLIMITED
+    bool is_extensible() const
+    {
+      hsize_t dims[H5S_MAX_RANK], maxdims[H5S_MAX_RANK];
+      int r = get_dims(dims, maxdims);
+      for (int i = 0; i < r; ++i)
+        if (maxdims[i] == H5S_UNLIMITED) return true;
+      return false;
+    }
     
     bool is_simple() const
     {
@@ -531,6 +888,38 @@ class Dataspace : public Object
         throw Exception("unable to select hyperslab");
     }
 
+    // combines the hyperslab with the current selection, e.g. by H5S_SELECT_OR for the union
+    void select_hyperslab(H5S_seloper_t op, const hsize_t* offset, const hsize_t* stride, const hsize_t* count, const hsize_t *block)
+    {
+      herr_t r= H5Sselect_hyperslab(get_id(), op, offset, stride, count, block);
+      if (r < 0)
+        throw Exception("unable to select hyperslab");
+    }
+
+    // coords holds rank coordinates for each of the n points. op is H5S_SELECT_SET, APPEND or PREPEND
+    void select_elements(H5S_seloper_t op, size_t n, const hsize_t *coords)
+    {
+      herr_t r = H5Sselect_elements(get_id(), op, n, coords);
+      if (r < 0)
+        throw Exception("unable to select elements");
+    }
+
+    void select_none()
+    {
+      herr_t r = H5Sselect_none(get_id());
+      if (r < 0)
+        throw Exception("error clearing the selection");
+    }
+
+    // a copy with the same extent and selection
+    Dataspace copy() const
+    {
+      hid_t id = H5Scopy(get_id());
+      if (id < 0)
+        throw Exception("unable to copy dataspace");
+      return Dataspace(id, internal::NoIncRC());
+    }
+
     void select_all()
     {
       herr_t r = H5Sselect_all(get_id());
@@ -556,13 +945,146 @@ class Dataspace : public Object
 };
 
 
+/*
+  A block inside a larger N-d array in memory, e.g. the interior of a domain with ghost cells.
+  The array has dimensions extent. The block starts at offset and comprises count elements
+  per dimension, which are stride elements apart (NULL for 1). All arrays have rank entries.
+  Used to read and write datasets directly from and to such blocks, see Dataset::read.
+*/
+class ArrayBlock
+{
+    Dataspace space;
+    int rank;
+    hsize_t count[H5S_MAX_RANK];
+
+  public:
+    ArrayBlock(int rank_, const hsize_t *extent, const hsize_t *offset, const hsize_t *count_, const hsize_t *stride = NULL) : rank(rank_)
+    {
+      for (int i = 0; i < rank; ++i)
+      {
+        hsize_t last = offset[i] + (count_[i] > 0 ? (count_[i] - 1) * (stride ? stride[i] : 1) : 0);
+        if (last >= extent[i])
+          throw Exception("array block exceeds the extent of the array");
+        count[i] = count_[i];
+      }
+      space = Dataspace::simple(rank, extent);
+      space.select_hyperslab(H5S_SELECT_SET, offset, stride, count, NULL);
+    }
+
+    // the dataspace of the whole array, with the block selected
+    const Dataspace& get_space() const { return space; }
+
+    int get_rank() const { return rank; }
+
+    const hsize_t* get_count() const { return count; }
+
+    hssize_t get_npoints() const { return space.get_select_npoints(); }
+};
+
+
+/*
+  The block of a global N-d array owned by process proc of nprocs, e.g. the part of a field which
+  an MPI rank of a simulation writes. The processes form a grid in C order, like a cartesian MPI
+  communicator. Unless given, its shape is chosen to make the blocks about cubic. Blocks differ by
+  at most one element per dimension. Processes own no elements if there are more than elements.
+*/
+class BlockDecomposition
+{
+    int rank;
+    int grid[H5S_MAX_RANK], coords[H5S_MAX_RANK];
+    hsize_t dims[H5S_MAX_RANK], offset[H5S_MAX_RANK], count[H5S_MAX_RANK];
+
+    // distributes the prime factors of nprocs, largest first, to the dimensions with the longest blocks
+    void make_grid(int nprocs)
+    {
+      std::vector<int> factors;
+      for (int f = 2; f * f <= nprocs; ++f)
+        for (; nprocs % f == 0; nprocs /= f)
+          factors.push_back(f);
+      if (nprocs > 1)
+        factors.push_back(nprocs);
+      for (int k = int(factors.size()) - 1; k >= 0; --k)
+      {
+        int longest = 0;
+        for (int i = 1; i < rank; ++i)
+          if (double(dims[i]) / grid[i] > double(dims[longest]) / grid[longest]) longest = i;
+        grid[longest] *= factors[k];
+      }
+    }
+
+  public:
+    BlockDecomposition(int rank_, const hsize_t *global_dims, int nprocs, int proc, const int *grid_ = NULL) : rank(rank_)
+    {
+      if (rank < 1 || rank > H5S_MAX_RANK || nprocs < 1 || proc < 0 || proc >= nprocs)
+        throw Exception("invalid block decomposition");
+      for (int i = 0; i < rank; ++i)
+      {
+        dims[i] = global_dims[i];
+        grid[i] = grid_ ? grid_[i] : 1;
+        if (grid[i] < 1)
+          throw Exception("invalid process grid");
+      }
+      if (!grid_)
+        make_grid(nprocs);
+      int n = 1;
+      for (int i = 0; i < rank; ++i)
+        n *= grid[i];
+      if (n != nprocs)
+        throw Exception("process grid does not match the number of processes");
+      for (int i = rank - 1, rest = proc; i >= 0; --i)
+      {
+        coords[i] = rest % grid[i];
+        rest /= grid[i];
+      }
+      for (int i = 0; i < rank; ++i)
+      {
+        hsize_t base = dims[i] / grid[i], extra = dims[i] % grid[i], c = coords[i];
+        count[i] = base + (c < extra ? 1 : 0);
+        offset[i] = c * base + std::min(c, extra);
+      }
+    }
+
+    int get_rank() const { return rank; }
+    const int* get_grid() const { return grid; }
+    const int* get_coords() const { return coords; } // of this process in the grid
+    const hsize_t* get_offset() const { return offset; }
+    const hsize_t* get_count() const { return count; }
+
+    hsize_t get_npoints() const
+    {
+      hsize_t n = 1;
+      for (int i = 0; i < rank; ++i)
+        n *= count[i];
+      return n;
+    }
+
+    // selects the block in the dataspace of the global array, or nothing if it is empty
+    void select(Dataspace &file_space) const
+    {
+      if (get_npoints() == 0)
+        file_space.select_none();
+      else
+        file_space.select_hyperslab(H5S_SELECT_SET, offset, NULL, count, NULL);
+    }
+
+    // the elements of the block in a contiguous buffer, in C order
+    Dataspace get_mem_space() const
+    {
+      hsize_t maxdims[H5S_MAX_RANK];
+      for (int i = 0; i < rank; ++i)
+        maxdims[i] = std::max<hsize_t>(count[i], 1); // H5Screate_simple does not like zero sized maximal dimensions
+      return Dataspace::simple(rank, count, maxdims);
+    }
+};
+
+
 class Attribute : public Object
 {
   friend class Attributes;
   friend class RWattribute;
     using Object::inc_ref;
   private:       
-    Attribute(hid_t id, internal::NoIncRC) : Object(id) {}
+    Attribute(hid_t id, internal::NoIncRC) : Object(id, internal::NoIncRC()) {}
       
     Attribute(hid_t loc_id, const std::string &name, hid_t type_id, hid_t space_id, hid_t acpl_id, hid_t aapl_id, internal::TagCreate)
     {
@@ -599,14 +1121,14 @@ class Attribute : public Object
       hid_t type_id = H5Aget_type(this->id);
       if (type_id<0)
         throw Exception("unable to get type of Attribute");
-      return Datatype(type_id);
+      return Datatype(type_id, internal::NoIncRC());
     }
 
     /* assuming that the memory dataspace equals disk dataspace */
     template<class T>
     void read(T *values) const
     {
-      Datatype memtype = get_memtype<T>();
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
       RWattribute rw(this->get_id(), memtype.get_id());
       h5traits_of<T>::type::read(rw, memtype, get_dataspace(), values);
     }
@@ -615,10 +1137,23 @@ class Attribute : public Object
     template<class T>
     void write(T* values)
     {
-      Datatype memtype = get_memtype<T>();
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
       RWattribute rw(this->get_id(), memtype.get_id());
       h5traits_of<T>::type::write(rw, memtype, get_dataspace(), values);
     }
+
+    // reads with an explicitly given memory type, which describes the layout of the buffer
+    void read(const Datatype &memtype, void *buf) const
+    {
+      RWattribute rw(this->get_id(), memtype.get_id());
+      rw.read(buf);
+    }
+
+    void write(const Datatype &memtype, const void *buf)
+    {
+      RWattribute rw(this->get_id(), memtype.get_id());
+      rw.write(buf);
+    }
 };
 
 
@@ -638,10 +1173,20 @@ class Attributes
       return Attribute(attributed_object.get_id(), name, H5P_DEFAULT, internal::TagOpen());
     }
 
+    Attribute create(const std::string &name, const Datatype &disktype, const Dataspace &space)
+    {
+      return Attribute(attributed_object.get_id(),
+                       name,
+                       disktype.get_id(),
+                       space.get_id(),
+                       H5P_DEFAULT, H5P_DEFAULT,
+                       internal::TagCreate());
+    }
+
     template<class T>
     Attribute create(const std::string &name, const Dataspace &space)
     {
-      Datatype disktype = get_disktype<T>();
+      const Datatype &disktype = internal::TypeRegistry<T>::disktype();
       Attribute a(attributed_object.get_id(),
                   name,
                   disktype.get_id(),
@@ -707,6 +1252,74 @@ class Attributes
       else throw Exception("error looking for attribute by name");
     }
 
+    // does not throw. ec is set to ERROR_LIBRARY if the existence cannot be determined
+    bool exists(const std::string &name, std::error_code &ec) const
+    {
+      htri_t res = H5Aexists(attributed_object.get_id(), name.c_str());
+      if (res < 0) ec = make_error_code(ERROR_LIBRARY);
+      else ec.clear();
+      return res > 0;
+    }
+
+    // does not throw. ec is set to ERROR_NOT_FOUND or ERROR_LIBRARY, the attribute is then invalid
+    Attribute open(const std::string &name, std::error_code &ec)
+    {
+      Attribute a;
+      if (exists(name, ec))
+      {
+        a.id = H5Aopen(attributed_object.get_id(), name.c_str(), H5P_DEFAULT);
+        if (a.id < 0) ec = make_error_code(ERROR_LIBRARY);
+      }
+      else if (!ec)
+        ec = make_error_code(ERROR_NOT_FOUND);
+      return a;
+    }
+
+    // does not throw, otherwise like set(const std::string&, Dataspace, const T*)
+    template<class T>
+    void set(const std::string &name, Dataspace space, const T* values, std::error_code &ec)
+    {
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+      hid_t obj_id = attributed_object.get_id();
+      Attribute a = open(name, ec);
+      if (ec && ec != ERROR_NOT_FOUND)
+        return;
+      if (a.is_valid())
+      {
+        hid_t space_id = H5Aget_space(a.get_id());
+        htri_t equal = space_id >= 0 ? H5Sextent_equal(space_id, space.get_id()) : -1;
+        if (space_id >= 0) H5Sclose(space_id);
+        if (equal > 0)
+        {
+          RWattribute rw(a.get_id(), memtype.get_id(), &ec);
+          h5traits_of<T>::type::write(rw, memtype, space, values);
+          if (!ec) return;
+        }
+        a = Attribute();
+        if (H5Adelete(obj_id, name.c_str()) < 0)
+        {
+          ec = make_error_code(ERROR_LIBRARY);
+          return;
+        }
+      }
+      ec.clear();
+      hid_t id = H5Acreate2(obj_id, name.c_str(), internal::TypeRegistry<T>::disktype().get_id(), space.get_id(), H5P_DEFAULT, H5P_DEFAULT);
+      if (id < 0)
+      {
+        ec = make_error_code(ERROR_LIBRARY);
+        return;
+      }
+      a = Attribute(id, internal::NoIncRC());
+      RWattribute rw(a.get_id(), memtype.get_id(), &ec);
+      h5traits_of<T>::type::write(rw, memtype, space, values);
+    }
+
+    template<class T>
+    void set(const std::string &name, const T &value, std::error_code &ec)
+    {
+      set(name, Dataspace::scalar(), &value, ec);
+    }
+
     hsize_t size() const
     {
       hid_t objid = attributed_object.get_id();
@@ -746,11 +1359,111 @@ class Attributes
       if (err < 0)
         throw Exception("error deleting attribute");
     }
-};
-
+
+    /*
+      Creates or overwrites all attributes of the batch. The existing attributes are found
+      in one pass instead of probing each name. An existing attribute is overwritten in place if
+      its type and extent are equal to the new ones, otherwise it is replaced.
+    */
+    void set(const AttributeBatch &batch);
+
+    // reads all attributes in one pass
+    void get_all(AttributeValues &values);
+};
+
+
+// the dominant way a dataset is accessed, a hint for plan_chunk_dims
+enum AccessPattern
+{
+  ACCESS_ANY = 0,  // no preference, chunks with similar extent in each dimension
+  ACCESS_ROWS,     // runs along the last dimension, e.g. rows of a matrix
+  ACCESS_COLUMNS,  // runs along the first dimension, e.g. columns of a matrix
+  ACCESS_TILES,    // blocks, same as ACCESS_ANY
+  ACCESS_APPEND    // records appended along the first dimension, see AppendWriter
+};
+
+/*
+  Chunk dimensions for a dataset of the given space, so that chunks hold about target_bytes.
+  Chunks of runs along rows or columns span these dimensions as far as the target allows,
+  otherwise the largest dimension is halved until the chunk is small enough. Unlimited
+  dimensions are treated as long. Datasets smaller than the target become one chunk.
+  The default target fits a few chunks into the default chunk cache of 1 MiB. Returns the rank.
+*/
+inline int plan_chunk_dims(const Dataspace &sp, size_t element_size, hsize_t *cdims, AccessPattern pattern = ACCESS_ANY, size_t target_bytes = HDF_WRAPPER_CHUNK_TARGET_BYTES)
+{
+  hsize_t dims[H5S_MAX_RANK], maxdims[H5S_MAX_RANK], extent[H5S_MAX_RANK];
+  int r = sp.get_dims(dims, maxdims);
+  const hsize_t n = std::max<hsize_t>(1, target_bytes / std::max<size_t>(1, element_size)); // elements per chunk
+  for (int i = 0; i < r; ++i)
+    extent[i] = maxdims[i] == H5S_UNLIMITED ? n : std::max<hsize_t>(1, maxdims[i]);
+
+  if (pattern == ACCESS_ROWS || pattern == ACCESS_COLUMNS || pattern == ACCESS_APPEND)
+  {
+    hsize_t left = n;
+    for (int j = 0; j < r; ++j)
+    {
+      int i = pattern == ACCESS_COLUMNS ? j : r - 1 - j;
+      cdims[i] = std::max<hsize_t>(1, std::min(extent[i], left));
+      left /= cdims[i];
+    }
+    return r;
+  }
+
+  for (int i = 0; i < r; ++i)
+    cdims[i] = extent[i];
+  while (true)
+  {
+    double size = 1.; // may exceed the range of hsize_t for the full extent
+    int largest = 0;
+    for (int i = 0; i < r; ++i)
+    {
+      size *= cdims[i];
+      if (cdims[i] > cdims[largest]) largest = i;
+    }
+    if (size <= n || cdims[largest] <= 1)
+      break;
+    cdims[largest] = (cdims[largest] + 1) / 2;
+  }
+  return r;
+}
+
+
+// whether a filter can be used: built in, registered with register_filter or found as plugin
+inline bool is_filter_available(H5Z_filter_t filter_id)
+{
+  htri_t avail = H5Zfilter_avail(filter_id);
+  if (avail < 0)
+    throw Exception("error checking availability of filter "+std::to_string(filter_id));
+  return avail > 0;
+}
+
+/*
+  Registers a filter implemented by this program, so it can be added with Properties::filter.
+  The id must be one assigned by The HDF Group, or between 256 and 511 for testing.
+*/
+inline void register_filter(const H5Z_class2_t &filter_class)
+{
+  if (H5Zregister(&filter_class) < 0)
+    throw Exception("error registering filter "+std::string(filter_class.name ? filter_class.name : ""));
+}
+
 
 class Properties : protected Object
 {
+    friend class Dataset;
+    template<class T> friend class AppendWriter;
+    template<class T> friend class BlockReader;
+
+    // filters can be built with a decoder only, e.g. szip
+    static void require_filter(H5Z_filter_t filter_id)
+    {
+      unsigned int config = 0;
+      if (!is_filter_available(filter_id) || H5Zget_filter_info(filter_id, &config) < 0 || !(config & H5Z_FILTER_CONFIG_ENCODE_ENABLED))
+        throw Exception("filter not available for writing: "+std::to_string(filter_id));
+    }
+
+    Properties(hid_t id, internal::NoIncRC) : Object(id, internal::NoIncRC()) {} // takes ownership of an existing property list, e.g. from H5Dget_create_plist
+    Properties() : Object() {} // no list, stands for H5P_DEFAULT
   public:
     using Object::get_id;
     using Object::is_valid;
@@ -763,22 +1476,203 @@ class Properties : protected Object
         throw Exception("error creating property list");
     }
 
+    H5D_layout_t get_layout() const
+    {
+      H5D_layout_t l = H5Pget_layout(this->id);
+      if (l < 0)
+        throw Exception("error getting dataset layout");
+      return l;
+    }
+
+    // returns the chunk rank, or 0 if the layout is not chunked
+    int get_chunk(hsize_t *dims) const
+    {
+      if (get_layout() != H5D_CHUNKED)
+        return 0;
+      int r = H5Pget_chunk(this->id, H5S_MAX_RANK, dims);
+      if (r < 0)
+        throw Exception("error getting chunk dimensions");
+      return r;
+    }
+
+    int get_nfilters() const
+    {
+      int n = H5Pget_nfilters(this->id);
+      if (n < 0)
+        throw Exception("error getting number of filters");
+      return n;
+    }
+
+    /*
+      Returns the id of the filter at position idx in the pipeline. cd_values must hold
+      *cd_nelmts values. On return *cd_nelmts is the number of values the filter has.
+    */
+    H5Z_filter_t get_filter(int idx, unsigned int *flags = NULL, size_t *cd_nelmts = NULL, unsigned int *cd_values = NULL) const
+    {
+      unsigned int dummy_flags;
+      size_t dummy_nelmts = 0;
+      H5Z_filter_t f = H5Pget_filter2(this->id, idx, flags ? flags : &dummy_flags, cd_nelmts ? cd_nelmts : &dummy_nelmts, cd_values, 0, NULL, NULL);
+      if (f < 0)
+        throw Exception("error getting filter");
+      return f;
+    }
+
+    // file access: keep the file in memory, growing by increment bytes. see File::in_memory
+    Properties& core_driver(size_t increment = 1<<20, bool backing_store = false)
+    {
+      if (H5Pset_fapl_core(this->id, increment, backing_store) < 0)
+        throw Exception("error setting core driver");
+      return *this;
+    }
+
+    // file access: objects of at least threshold bytes start at multiples of alignment, see Dataset::map
+    Properties& alignment(hsize_t threshold, hsize_t alignment)
+    {
+      if (H5Pset_alignment(this->id, threshold, alignment) < 0)
+        throw Exception("error setting alignment");
+      return *this;
+    }
+
+    // file access: initial contents of a file on the core driver. the buffer is copied
+    Properties& file_image(const void *buf, size_t size)
+    {
+      if (H5Pset_file_image(this->id, const_cast<void*>(buf), size) < 0)
+        throw Exception("error setting file image");
+      return *this;
+    }
+
+    /*
+      dataset transfer: size of the type conversion and background buffers. Transfers which need
+      conversion are done in passes of at most this many bytes. The library default is 1 MiB.
+      Larger buffers mean fewer passes but more memory traffic; measure before raising it.
+    */
+    Properties& conversion_buffer(size_t size)
+    {
+      if (H5Pset_buffer(this->id, size, NULL, NULL) < 0)
+        throw Exception("error setting conversion buffer");
+      return *this;
+    }
+
+    // dataset transfer: number of hyperslab offset and length pairs gathered per I/O operation
+    Properties& hyper_vector_size(size_t n)
+    {
+      if (H5Pset_hyper_vector_size(this->id, n) < 0)
+        throw Exception("error setting hyperslab vector size");
+      return *this;
+    }
+
+    // dataset transfer: an arithmetic expression in x, applied when reading and writing, e.g. "2*x+1"
+    Properties& data_transform(const std::string &expression)
+    {
+      if (H5Pset_data_transform(this->id, expression.c_str()) < 0)
+        throw Exception("error setting data transform: "+expression);
+      return *this;
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    // file access: MPI-IO on the communicator, see File::parallel
+    Properties& mpio(MPI_Comm comm, MPI_Info info = MPI_INFO_NULL)
+    {
+      if (H5Pset_fapl_mpio(this->id, comm, info) < 0)
+        throw Exception("error setting MPI-IO driver");
+      return *this;
+    }
+
+    /*
+      dataset transfer: H5FD_MPIO_COLLECTIVE or H5FD_MPIO_INDEPENDENT. Collective transfers must be
+      done by all processes of the communicator, each with its own selection, which may be empty.
+    */
+    Properties& mpio_transfer(H5FD_mpio_xfer_t mode)
+    {
+      if (H5Pset_dxpl_mpio(this->id, mode) < 0)
+        throw Exception("error setting MPI-IO transfer mode");
+      return *this;
+    }
+#endif
+
+    // dataset transfer: whether checksums of filters like fletcher32 are verified when reading
+    Properties& edc_check(bool enable)
+    {
+      if (H5Pset_edc_check(this->id, enable ? H5Z_ENABLE_EDC : H5Z_DISABLE_EDC) < 0)
+        throw Exception("error setting error detection");
+      return *this;
+    }
+
     Properties& deflate(int strength = 9)
     {
       H5Pset_deflate(this->id, strength);
       return *this;
     };
 
+    /*
+      Filters of the chunk pipeline, applied in the order they are added when writing. Add
+      shuffle before deflate: grouping the bytes of the elements by significance makes floating
+      point data compress much better. fletcher32 should come last, so the checksum covers the
+      stored bytes. Filters which are not available throw, unless added with H5Z_FLAG_OPTIONAL.
+    */
+    Properties& shuffle()
+    {
+      return filter(H5Z_FILTER_SHUFFLE);
+    }
+
+    Properties& fletcher32()
+    {
+      return filter(H5Z_FILTER_FLETCHER32);
+    }
+
+    // packs integers and floats to the precision of their datatype, see H5Tset_precision
+    Properties& nbit()
+    {
+      return filter(H5Z_FILTER_NBIT);
+    }
+
+    // lossy for floats: H5Z_SO_FLOAT_DSCALE keeps factor decimal digits. for integers use H5Z_SO_INT with the number of bits or H5Z_SO_INT_MINBITS_DEFAULT
+    Properties& scaleoffset(H5Z_SO_scale_type_t scale_type, int factor)
+    {
+      require_filter(H5Z_FILTER_SCALEOFFSET);
+      if (H5Pset_scaleoffset(this->id, scale_type, factor) < 0)
+        throw Exception("error setting scaleoffset filter");
+      return *this;
+    }
+
+    // options_mask is H5_SZIP_NN_OPTION_MASK or H5_SZIP_EC_OPTION_MASK. pixels_per_block is even and at most 32
+    Properties& szip(unsigned int options_mask, unsigned int pixels_per_block)
+    {
+      require_filter(H5Z_FILTER_SZIP);
+      if (H5Pset_szip(this->id, options_mask, pixels_per_block) < 0)
+        throw Exception("error setting szip filter");
+      return *this;
+    }
+
+    // any filter by its id, e.g. one registered with register_filter or loaded as plugin
+    Properties& filter(H5Z_filter_t filter_id, unsigned int flags = H5Z_FLAG_MANDATORY, const std::vector<unsigned int> &cd_values = std::vector<unsigned int>())
+    {
+      if (!(flags & H5Z_FLAG_OPTIONAL))
+        require_filter(filter_id);
+      if (H5Pset_filter(this->id, filter_id, flags, cd_values.size(), cd_values.empty() ? NULL : &cd_values[0]) < 0)
+        throw Exception("error setting filter "+std::to_string(filter_id));
+      return *this;
+    }
+
     Properties& chunked(int rank, const hsize_t *dims)
     {
       H5Pset_chunk(this->id, rank, dims);
       return *this;
     }
 
+    // chunks of about target_bytes, shaped for the access pattern, see plan_chunk_dims
+    Properties& chunked_for(const Dataspace &sp, size_t element_size, AccessPattern pattern = ACCESS_ANY, size_t target_bytes = HDF_WRAPPER_CHUNK_TARGET_BYTES)
+    {
+      hsize_t cdims[H5S_MAX_RANK];
+      int r = plan_chunk_dims(sp, element_size, cdims, pattern, target_bytes);
+      return chunked(r, cdims);
+    }
+
+    // 10% of each dimension but at least 32. chunks of large datasets may get much bigger than the chunk cache, see chunked_for
     Properties& chunked_with_estimated_size(const Dataspace &sp)
     {
-      hsize_t dims[H5S_MAX_RANK];
-      int r = sp.get_dims(dims);
+      hsize_t dims[H5S_MAX_RANK], maxdims[H5S_MAX_RANK];
+      int r = sp.get_dims(dims, maxdims);
       hsize_t cdims[H5S_MAX_RANK];
       for (int i=0; i<r; ++i)
       {
@@ -787,7 +1681,7 @@ class Properties : protected Object
         val = (hsize_t)(val * 0.1);
         if (val < 32.)
           val = 32;
-        if (val > org_val)
+        if (val > org_val && maxdims[i] != H5S_UNLIMITED) // unlimited dimensions will grow beyond the current size
           val = org_val;
         cdims[i] = val;
       }
@@ -796,6 +1690,152 @@ class Properties : protected Object
 };
 
 
+/*
+  Configuration of the raw data chunk cache of a dataset, see H5Pset_chunk_cache.
+  nbytes is the total size of the cache, nslots the number of hash table slots
+  and w0 the preemption policy. The HDF5 default is 1 MiB, 521 slots and w0 = 0.75.
+  Chunks larger than nbytes are not cached at all, which means that partial reads
+  decompress the same chunk again and again.
+*/
+struct ChunkCache
+{
+  size_t nbytes;
+  size_t nslots; // 0 = choose automatically, about 100 times the number of chunks that fit into the cache
+  double w0;
+  int    rank;   // for automatic sizing: rank of the hinted selection shape, or 0
+  hsize_t selection_dims[H5S_MAX_RANK];
+  bool   automatic;
+
+  ChunkCache(size_t nbytes_, size_t nslots_ = 0, double w0_ = 0.75) :
+    nbytes(nbytes_), nslots(nslots_), w0(w0_), rank(0), automatic(false) {}
+
+  // the library default cache
+  static ChunkCache defaults()
+  {
+    return ChunkCache(1024*1024, 521, 0.75);
+  }
+
+  /*
+    The cache is sized when the dataset is opened, such that all chunks intersecting a selection
+    of the given shape fit into the cache. Without selection shape, a slab one chunk thick along
+    the first dimension, spanning the remaining dimensions completely, is assumed.
+    The size is limited to max_nbytes, but is always large enough to hold at least one chunk.
+  */
+  static ChunkCache automatic_size(int rank = 0, const hsize_t *selection_dims = NULL, size_t max_nbytes = 256*1024*1024)
+  {
+    ChunkCache c(max_nbytes);
+    c.automatic = true;
+    c.rank = rank;
+    for (int i = 0; i < rank; ++i)
+      c.selection_dims[i] = selection_dims[i];
+    return c;
+  }
+
+  // sizes a cache for repeated accesses like the given file space selection
+  static ChunkCache automatic_size(const Dataspace &selection, size_t max_nbytes = 256*1024*1024)
+  {
+    hsize_t start[H5S_MAX_RANK], end[H5S_MAX_RANK];
+    int r = selection.get_rank();
+    if (H5Sget_select_bounds(selection.get_id(), start, end) < 0)
+      throw Exception("unable to get selection bounds");
+    for (int i = 0; i < r; ++i)
+      end[i] = end[i] - start[i] + 1;
+    return automatic_size(r, end, max_nbytes);
+  }
+};
+
+
+namespace internal
+{
+
+inline size_t next_prime(size_t n)
+{
+  if (n < 2) return 2;
+  for (;; ++n)
+  {
+    bool prime = true;
+    for (size_t d = 2; d * d <= n && prime; ++d)
+      prime = (n % d) != 0;
+    if (prime) return n;
+  }
+}
+
+} // namespace internal
+
+
+// a link in a group, see Group::list
+struct LinkInfo
+{
+  std::string name;
+  H5L_type_t link_type;     // hard, soft or external
+  H5O_type_t object_type;   // H5O_TYPE_UNKNOWN unless it was looked up and the link is hard
+  bool has_creation_order;  // only if the group tracks creation order
+  int64_t creation_order;
+
+  bool is_group() const { return object_type == H5O_TYPE_GROUP; }
+  bool is_dataset() const { return object_type == H5O_TYPE_DATASET; }
+};
+
+
+namespace internal
+{
+
+// 1.12 introduced H5O_info2_t, the functions taking the old struct are deprecated there
+#if H5_VERSION_GE(1,12,0)
+typedef H5O_info2_t ObjectInfo;
+#else
+typedef H5O_info_t ObjectInfo;
+#endif
+
+// the basic info, e.g. the type, of the object name refers to. skips the header and attribute details where possible
+inline herr_t get_basic_object_info(hid_t loc_id, const char *name, ObjectInfo *info)
+{
+#if H5_VERSION_GE(1,12,0)
+  return H5Oget_info_by_name3(loc_id, name, info, H5O_INFO_BASIC, H5P_DEFAULT);
+#elif H5_VERSION_GE(1,10,3)
+  return H5Oget_info_by_name2(loc_id, name, info, H5O_INFO_BASIC, H5P_DEFAULT);
+#else
+  return H5Oget_info_by_name(loc_id, name, info, H5P_DEFAULT);
+#endif
+}
+
+struct ListLinksOp
+{
+  const std::function<bool (const LinkInfo&)> *callback;
+  bool object_types;
+  std::string error;
+};
+
+inline herr_t list_link(hid_t group_id, const char *name, const H5L_info_t *info, void *op_data)
+{
+  ListLinksOp &op = *static_cast<ListLinksOp*>(op_data);
+  try
+  {
+    LinkInfo link;
+    link.name = name;
+    link.link_type = info->type;
+    link.object_type = H5O_TYPE_UNKNOWN;
+    link.has_creation_order = info->corder_valid;
+    link.creation_order = info->corder;
+    if (op.object_types && info->type == H5L_TYPE_HARD)
+    {
+      ObjectInfo oinfo;
+      if (get_basic_object_info(group_id, name, &oinfo) < 0)
+        throw Exception("cannot get info of object: " + link.name);
+      link.object_type = oinfo.type;
+    }
+    return (*op.callback)(link) ? 0 : 1; // a positive value stops the iteration
+  }
+  catch (const Exception &e)
+  {
+    op.error = e.what();
+    return -1;
+  }
+}
+
+} // namespace internal
+
+
 class iterator;
 
 class Group : public Object
@@ -827,6 +1867,32 @@ class Group : public Object
       return res > 0;
     }
 
+    /*
+      Does not throw. ec is set to ERROR_NOT_FOUND if a group on the path of name is missing,
+      for which the library would fail, and to ERROR_LIBRARY if the existence cannot be determined.
+    */
+    bool exists(const std::string &name, std::error_code &ec) const
+    {
+      ec.clear();
+      for (size_t pos = name.find('/', 1); pos != std::string::npos; pos = name.find('/', pos + 1))
+      {
+        htri_t res = H5Lexists(this->id, name.substr(0, pos).c_str(), H5P_DEFAULT);
+        if (res == 0)
+        {
+          ec = make_error_code(ERROR_NOT_FOUND);
+          return false;
+        }
+        if (res < 0)
+        {
+          ec = make_error_code(ERROR_LIBRARY);
+          return false;
+        }
+      }
+      htri_t res = H5Lexists(this->id, name.c_str(), H5P_DEFAULT);
+      if (res < 0) ec = make_error_code(ERROR_LIBRARY);
+      return res > 0;
+    }
+
     // number of links in the group
     hsize_t size() const
     {
@@ -851,11 +1917,39 @@ class Group : public Object
 		{
 			return Group(this->id, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT, internal::TagCreate());
 		}
+
+    // as above, the new group remembers the order in which links are created, see list
+    Group create_group(const std::string &name, bool track_creation_order)
+    {
+      if (!track_creation_order)
+        return create_group(name);
+      Properties gcpl(H5P_GROUP_CREATE);
+      if (H5Pset_link_creation_order(gcpl.get_id(), H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED) < 0)
+        throw Exception("cannot set link creation order");
+      return Group(this->id, name.c_str(), H5P_DEFAULT, gcpl.get_id(), H5P_DEFAULT, internal::TagCreate());
+    }
 		
 		Group open_group(const std::string &name)
 		{
 			return Group(this->id, name.c_str(), H5P_DEFAULT, internal::TagOpen());
 		}
+
+    /*
+      Does not throw. If there is no link of this name, ec is set to ERROR_NOT_FOUND, on other
+      errors to ERROR_LIBRARY. The returned group is then invalid.
+    */
+    Group open_group(const std::string &name, std::error_code &ec)
+    {
+      Group g;
+      if (exists(name, ec))
+      {
+        g.id = H5Gopen2(this->id, name.c_str(), H5P_DEFAULT);
+        if (g.id < 0) ec = make_error_code(ERROR_LIBRARY);
+      }
+      else if (!ec)
+        ec = make_error_code(ERROR_NOT_FOUND);
+      return g;
+    }
 		
 		Group require_group(const std::string &name, bool *had_group = NULL)
 		{
@@ -878,6 +1972,16 @@ class Group : public Object
     
     Dataset open_dataset(const std::string &name);
 
+    // does not throw, see open_group(const std::string&, std::error_code&)
+    Dataset open_dataset(const std::string &name, std::error_code &ec);
+
+    /*
+      Opens the dataset with the given chunk cache configuration. The cache belongs to the
+      underlying dataset object, so it only takes effect if the dataset is not open elsewhere already.
+      HDF5 does not report cache hits and misses, so judge a configuration by measuring read times.
+    */
+    Dataset open_dataset(const std::string &name, const ChunkCache &cache);
+
 #ifdef HDF_WRAPPER_HAS_BOOST
     boost::optional<Dataset> try_open_dataset(const std::string &name);
 #endif
@@ -889,6 +1993,28 @@ class Group : public Object
         throw Exception("cannot remove link from group");
     }
 
+    /*
+      Visits all links in one pass, in the order of index. H5_INDEX_CRT_ORDER requires a group
+      created with track_creation_order. The callback returns false to stop early.
+      With object_types, the type of the object of each hard link is looked up, too.
+    */
+    void for_each_link(const std::function<bool (const LinkInfo&)> &callback, bool object_types = true, H5_index_t index = H5_INDEX_NAME) const
+    {
+      internal::ListLinksOp op = { &callback, object_types, std::string() };
+      hsize_t idx = 0;
+      if (H5Literate(this->id, index, H5_ITER_INC, &idx, internal::list_link, &op) < 0)
+        throw Exception(op.error.empty() ? std::string("cannot iterate over links in group") : op.error);
+    }
+
+    // a snapshot of all links, see for_each_link
+    std::vector<LinkInfo> list(bool object_types = true, H5_index_t index = H5_INDEX_NAME) const
+    {
+      std::vector<LinkInfo> links;
+      links.reserve(size());
+      for_each_link([&links](const LinkInfo &link) { links.push_back(link); return true; }, object_types, index);
+      return links;
+    }
+
     iterator begin();
     iterator end();
 };
@@ -904,7 +2030,7 @@ class iterator : public std::iterator<std::bidirectional_iterator_tag, std::stri
     hssize_t idx;
     Group g;
     friend class Group;
-    iterator(hssize_t idx_, Group g_) : idx(idx_), g(g_) {}
+    iterator(hssize_t idx_, Group g_) : idx(idx_), g(std::move(g_)) {}
   public:
     iterator()  : idx(std::numeric_limits<int>::max()) {}
     iterator& operator++() { ++idx; return *this; }
@@ -934,10 +2060,10 @@ inline iterator Group::end()
 
 class File : public Object
 {
-    File(hid_t id, internal::NoIncRC) : Object(id) {} // takes a file handle that needs to be closed.
+    File(hid_t id, internal::NoIncRC) : Object(id, internal::NoIncRC()) {} // takes a file handle that needs to be closed.
     friend class Object; // because Object need to construct File using the above constructor.
   public:
-    explicit File(hid_t id) : Object() { this->inc_ref(); } // a logical copy of the original given by id, we inc reference count so the source can release its handle
+    explicit File(hid_t id) : Object(id) { this->inc_ref(); } // a logical copy of the original given by id, we inc reference count so the source can release its handle
     
     /*
       w = create or truncate existing file
@@ -947,6 +2073,80 @@ class File : public Object
       r+ = read/write; file must exist
     */
     File(const std::string &name, const std::string openmode = "w") : Object()
+    {
+      open_with(name, openmode, H5P_DEFAULT);
+    }
+
+    // as above, with file access properties, e.g. to select a driver
+    File(const std::string &name, const std::string openmode, const Properties &fapl) : Object()
+    {
+      open_with(name, openmode, fapl.get_id());
+    }
+
+    /*
+      A file which lives in memory (core driver). With backing_store, the file named name is
+      read on opening and the contents are written back to it on flush and close. Otherwise the
+      file system is only read when opening an existing file with mode "r", "r+" or "a", and name
+      merely identifies the file.
+    */
+    static File in_memory(const std::string &name, const std::string openmode = "w", bool backing_store = false, size_t increment = 1<<20)
+    {
+      Properties fapl(H5P_FILE_ACCESS);
+      fapl.core_driver(increment, backing_store);
+      return File(name, openmode, fapl);
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    /*
+      Opens the file with MPI-IO on all processes of comm, which must call this together. So must
+      they create groups, datasets and attributes and change extents. Each process may write and
+      read its own selections, see BlockDecomposition and Properties::mpio_transfer.
+    */
+    static File parallel(const std::string &name, const std::string &openmode, MPI_Comm comm, MPI_Info info = MPI_INFO_NULL)
+    {
+      Properties fapl(H5P_FILE_ACCESS);
+      fapl.mpio(comm, info);
+      return File(name, openmode, fapl);
+    }
+#endif
+
+    /*
+      Opens an in memory copy of the file image in buf, e.g. one made by get_image.
+      With openmode "r+" the copy can be modified. buf is not referenced after the call.
+    */
+    static File from_image(const void *buf, size_t size, const std::string openmode = "r")
+    {
+      if (openmode != "r" && openmode != "r+")
+        throw Exception("bad openmode for file image: " + openmode);
+      Properties fapl(H5P_FILE_ACCESS);
+      fapl.core_driver(size > 0 ? size : 1, false).file_image(buf, size);
+      return File("file_image", openmode, fapl);
+    }
+
+    // the file as a byte buffer, as it would be stored on disk
+    std::vector<char> get_image()
+    {
+      if (!is_readonly())
+        flush();
+      ssize_t size = H5Fget_file_image(this->id, NULL, 0);
+      if (size < 0)
+        throw Exception("unable to get size of file image");
+      std::vector<char> buf(size);
+      if (size > 0 && H5Fget_file_image(this->id, &buf[0], buf.size()) < 0)
+        throw Exception("unable to get file image");
+      return buf;
+    }
+    
+    File() : Object() {}
+    
+    void open(const std::string &name, const std::string openmode = "w")
+    {
+      this->~File();
+      new (this) File(name, openmode);
+    }
+    
+  private:
+    void open_with(const std::string &name, const std::string &openmode, hid_t fapl_id)
     {
       bool call_open = true;
       unsigned int flags; 
@@ -980,21 +2180,14 @@ class File : public Object
       else
         throw Exception("bad openmode: " + openmode);
       if (call_open)
-        this->id = H5Fopen(name.c_str(), flags , H5P_DEFAULT);
+        this->id = H5Fopen(name.c_str(), flags , fapl_id);
       else
-        this->id = H5Fcreate(name.c_str(), flags , H5P_DEFAULT, H5P_DEFAULT);
+        this->id = H5Fcreate(name.c_str(), flags , H5P_DEFAULT, fapl_id);
       if (this->id < 0)
         throw Exception("unable to open file: " + name);
     }
-    
-    File() : Object() {}
-    
-    void open(const std::string &name, const std::string openmode = "w")
-    {
-      this->~File();
-      new (this) File(name, openmode);
-    }
-    
+
+  public:
     void close()
     {
       if (this->id == -1) return;
@@ -1038,11 +2231,108 @@ inline File Object::get_file() const
 }
 
 
+#ifdef HDF_WRAPPER_HAS_MMAP
+namespace internal
+{
+// a read only memory mapping of a byte range of a file
+class FileMapping
+{
+    void *base;
+    size_t length;
+    const char *data;
+  public:
+    FileMapping(const std::string &filename, haddr_t offset, size_t nbytes) : base(MAP_FAILED), length(0), data(NULL)
+    {
+      int fd = ::open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+        throw Exception("unable to open file for mapping: " + filename);
+      size_t page = (size_t)sysconf(_SC_PAGESIZE);
+      haddr_t start = offset - offset % page; // mmap wants offsets at page boundaries
+      length = nbytes + (size_t)(offset - start);
+      base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, (off_t)start);
+      ::close(fd); // the mapping keeps its own reference to the file
+      if (base == MAP_FAILED)
+        throw Exception("unable to map file: " + filename);
+      data = static_cast<const char*>(base) + (offset - start);
+    }
+
+    ~FileMapping()
+    {
+      if (base != MAP_FAILED)
+        munmap(base, length);
+    }
+
+    const char* get_data() const { return data; }
+
+  private:
+    FileMapping(const FileMapping &);
+    FileMapping& operator=(const FileMapping &);
+};
+}
+
+
+/*
+  A read only view of the elements of a dataset, mapped directly from the file, see Dataset::map.
+  Copies share the mapping. The view keeps the file open, and stays valid until the last copy
+  is destroyed. Writes to the dataset after it was mapped are not guaranteed to be visible.
+*/
+template<class T>
+class MappedArray
+{
+    friend class Dataset;
+    std::shared_ptr<internal::FileMapping> mapping;
+    File file;
+    const T *ptr;
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t npoints;
+
+  public:
+    MappedArray() : ptr(NULL), rank(0), npoints(0) {}
+
+    const T* data() const { return ptr; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + npoints; }
+    hsize_t size() const { return npoints; }
+    int get_rank() const { return rank; }
+    hsize_t get_dim(int i) const { assert(i >= 0 && i < rank); return dims[i]; }
+    File get_file() const { return file; }
+
+    const T& operator[](hsize_t i) const { assert(i < npoints); return ptr[i]; }
+
+    // element at the multi dimensional index idx[0..rank-1], in row major order
+    const T& at(const hsize_t *idx) const
+    {
+      hsize_t k = 0;
+      for (int i = 0; i < rank; ++i)
+      {
+        if (idx[i] >= dims[i])
+          throw Exception("index out of range of mapped dataset");
+        k = k * dims[i] + idx[i];
+      }
+      return ptr[k];
+    }
+
+    template<class... I>
+    const T& operator()(I... i) const
+    {
+      const hsize_t idx[] = { hsize_t(i)... };
+      assert(sizeof...(I) == (size_t)rank);
+      return at(idx);
+    }
+};
+#endif
+
+
 enum DsCreationFlags
 {
   CREATE_DS_0 = 0,
   CREATE_DS_COMPRESSED = 1,
   CREATE_DS_CHUNKED = 2,
+  CREATE_DS_NATIVE_ORDER = 4, // numbers are stored in the byte order of this machine instead of little endian
+  CREATE_DS_BIG_ENDIAN = 8,
+  CREATE_DS_SHUFFLE = 16, // before compression, see Properties::shuffle
+  CREATE_DS_FLETCHER32 = 32, // checksums of chunks
 #ifndef HDF_WRAPPER_DS_CREATION_DEFAULT_FLAGS
   #ifdef H5_HAVE_FILTER_DEFLATE
     CREATE_DS_DEFAULT = CREATE_DS_COMPRESSED
@@ -1054,6 +2344,24 @@ enum DsCreationFlags
 #endif
 };
 
+inline DsCreationFlags operator|(DsCreationFlags a, DsCreationFlags b)
+{
+  return DsCreationFlags(int(a) | int(b));
+}
+
+namespace internal
+{
+// the byte order of disk types selected by the creation flags
+inline H5T_order_t disk_byte_order(DsCreationFlags flags)
+{
+  if (flags & CREATE_DS_BIG_ENDIAN)
+    return H5T_ORDER_BE;
+  if (flags & CREATE_DS_NATIVE_ORDER)
+    return H5Tget_order(H5T_NATIVE_INT);
+  return H5T_ORDER_LE;
+}
+}
+
 
 
 
@@ -1069,29 +2377,47 @@ class Dataset : public Object
         throw Exception("unable to open dataset: "+name);
     }
 
+    // an empty list stands for H5P_DEFAULT
+    static hid_t transfer_id(const Properties &xfer)
+    {
+      return xfer.get_id() < 0 ? H5P_DEFAULT : xfer.get_id();
+    }
+
     template<class T>
-    void write(Dataspace memspace, hid_t disk_space_id, const T* data)
+    void write(const Dataspace &memspace, hid_t disk_space_id, const T* data, const Properties *xfer = NULL)
     {
-      Datatype  memtype = get_memtype<T>();
-      RWdataset rw(get_id(), memtype.get_id(), memspace.get_id(), disk_space_id);
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+      RWdataset rw(get_id(), memtype.get_id(), memspace.get_id(), disk_space_id, xfer ? transfer_id(*xfer) : H5P_DEFAULT);
       h5traits_of<T>::type::write(rw, memtype, memspace, data);
     }
 
     template<class T>
-    void read(Dataspace memspace, hid_t disk_space_id, T* data) const
+    void read(const Dataspace &memspace, hid_t disk_space_id, T* data, const Properties *xfer = NULL) const
     {
-      Datatype memtype = get_memtype<T>();
-      RWdataset rw(get_id(), memtype.get_id(), memspace.get_id(), disk_space_id);
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+      RWdataset rw(get_id(), memtype.get_id(), memspace.get_id(), disk_space_id, xfer ? transfer_id(*xfer) : H5P_DEFAULT);
       h5traits_of<T>::type::read(rw, memtype, memspace, data);
     }
 
-    Dataset(hid_t id, internal::NoIncRC) : Object(id) {} // we get an existing reference, no need to increase the ref count. it will only be lowered by one when the instance is destroyed.
+    Dataset(hid_t id, internal::NoIncRC) : Object(id, internal::NoIncRC()) {} // we get an existing reference, no need to increase the ref count. it will only be lowered by one when the instance is destroyed.
+
+    // the library only checks the number of elements, which would silently reorder them
+    void check_block_shape(const ArrayBlock &block) const
+    {
+      hsize_t dims[H5S_MAX_RANK];
+      int r = get_dataspace().get_dims(dims);
+      bool equal = r == block.get_rank();
+      for (int i = 0; equal && i < r; ++i)
+        equal = dims[i] == block.get_count()[i];
+      if (!equal)
+        throw Exception("shape of array block differs from that of the dataset");
+    }
     
   public:
     Dataset() : Object() {}
     explicit Dataset(hid_t id) : Object(id) { Object::inc_ref(); } // we manage the new reference
     
-    static Dataset create(Group group, const std::string &name, const Datatype& dtype, const Dataspace &space, const Properties &prop)
+    static Dataset create(const Group &group, const std::string &name, const Datatype& dtype, const Dataspace &space, const Properties &prop)
     {
       hid_t id = H5Dcreate2(group.get_id(), name.c_str(),
                             dtype.get_id(), space.get_id(),
@@ -1102,9 +2428,10 @@ class Dataset : public Object
     }
    
     template<class T>
-    static Dataset create(Group group, const std::string &name, const Dataspace &space, DsCreationFlags flags = CREATE_DS_DEFAULT)
+    static Dataset create(const Group &group, const std::string &name, const Dataspace &space, DsCreationFlags flags = CREATE_DS_DEFAULT, AccessPattern pattern = ACCESS_ANY)
     {
-      return Dataset::create(group, name, get_disktype<T>(), space, create_creation_properties(space, flags));
+      const Datatype &dtype = internal::TypeRegistry<T>::disktype(internal::disk_byte_order(flags));
+      return Dataset::create(group, name, dtype, space, create_creation_properties(space, flags, dtype.get_size(), pattern));
     }
 
     template<class T>
@@ -1120,13 +2447,62 @@ class Dataset : public Object
       write(ds, H5S_ALL, data);
     }
 
-    static Properties create_creation_properties(const Dataspace &sp, DsCreationFlags flags)
+    /*
+      The read and write overloads taking a Properties object use it as transfer property list,
+      see Properties::conversion_buffer and the following. Otherwise H5P_DEFAULT is used.
+    */
+    template<class T>
+    void write(const Dataspace &mem_space, const Dataspace &file_space, const T* data, const Properties &xfer)
+    {
+      write(mem_space, file_space.get_id(), data, &xfer);
+    }
+
+    template<class T>
+    void write(const T* data, const Properties &xfer)
+    {
+      Dataspace ds = get_dataspace();
+      write(ds, H5S_ALL, data, &xfer);
+    }
+
+    // does not throw. ec is set to ERROR_LIBRARY on errors
+    template<class T>
+    void write(const T *data, std::error_code &ec)
+    {
+      write(data, Properties(), ec);
+    }
+
+    template<class T>
+    void write(const T *data, const Properties &xfer, std::error_code &ec)
+    {
+      ec.clear();
+      hid_t space_id = H5Dget_space(this->id);
+      if (space_id < 0)
+      {
+        ec = make_error_code(ERROR_LIBRARY);
+        return;
+      }
+      Dataspace memspace(space_id, internal::NoIncRC());
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+      RWdataset rw(get_id(), memtype.get_id(), H5S_ALL, H5S_ALL, transfer_id(xfer), &ec);
+      h5traits_of<T>::type::write(rw, memtype, memspace, data);
+    }
+
+    /*
+      Chunks are planned for elements of element_size bytes and the access pattern, see plan_chunk_dims.
+      The element size is that of the disk type, the default is meant for numbers.
+    */
+    static Properties create_creation_properties(const Dataspace &sp, DsCreationFlags flags, size_t element_size = sizeof(double), AccessPattern pattern = ACCESS_ANY)
     {
       Properties prop(H5P_DATASET_CREATE);
+      const int filters = CREATE_DS_COMPRESSED | CREATE_DS_SHUFFLE | CREATE_DS_FLETCHER32;
+      if (flags & CREATE_DS_SHUFFLE)
+        prop.shuffle();
       if (flags & CREATE_DS_COMPRESSED)
         prop.deflate();
-      if (flags & CREATE_DS_CHUNKED || flags & CREATE_DS_COMPRESSED)
-        prop.chunked_with_estimated_size(sp);
+      if (flags & CREATE_DS_FLETCHER32)
+        prop.fletcher32();
+      if (flags & CREATE_DS_CHUNKED || flags & filters || sp.is_extensible()) // filtered and extensible datasets must be chunked
+        prop.chunked_for(sp, element_size, pattern);
       return prop;
     }
     
@@ -1148,131 +2524,556 @@ class Dataset : public Object
       hid_t type_id = H5Dget_type(this->id);
       if (type_id<0)
         throw Exception("unable to get type of Attribute");
-      return Datatype(type_id);
+      return Datatype(type_id, internal::NoIncRC());
     }
 
-    template<class T>
-    void read(T *data) const
+    Properties get_creation_properties() const
     {
-      Dataspace ds = get_dataspace();
-      read(ds, H5S_ALL, data);
+      hid_t plist_id = H5Dget_create_plist(this->id);
+      if (plist_id < 0)
+        throw Exception("unable to get creation properties of dataset");
+      return Properties(plist_id, internal::NoIncRC());
     }
-};
 
+    // the chunk cache configuration this dataset was opened with
+    ChunkCache get_chunk_cache() const
+    {
+      hid_t dapl = H5Dget_access_plist(this->id);
+      if (dapl < 0)
+        throw Exception("unable to get access properties of dataset");
+      size_t nslots, nbytes;
+      double w0;
+      herr_t err = H5Pget_chunk_cache(dapl, &nslots, &nbytes, &w0);
+      H5Pclose(dapl);
+      if (err < 0)
+        throw Exception("unable to get chunk cache of dataset");
+      return ChunkCache(nbytes, nslots, w0);
+    }
 
+    /* 
+      Changes the current dimensions. Only possible for chunked datasets and
+      within the maximal dimensions of the dataspace the dataset was created with.
+    */
+    void set_extent(const hsize_t *dims)
+    {
+      herr_t err = H5Dset_extent(this->id, dims);
+      if (err < 0)
+        throw Exception("unable to change extent of dataset");
+    }
 
+#ifdef HDF_WRAPPER_HAS_MMAP
+    /*
+      Maps the elements into memory without copying. Requires a contiguous, unfiltered and allocated
+      dataset in a file on the default (sec2) driver, whose disk type equals the memory type of T.
+      Throws otherwise; use read in that case.
+    */
+    template<class T>
+    MappedArray<T> map() const;
+#endif
 
+    /*
+      Prepares repeated transfers between memspace and the selection in filespace, see WritePlan.
+      The selection can be moved between transfers.
+    */
+    template<class T>
+    WritePlan<T> prepare_write(const Dataspace &memspace, const Dataspace &filespace);
 
-inline Dataset Group::open_dataset(const std::string &name)
-{
-  return Dataset(this->id, name, H5P_DEFAULT, internal::TagOpen()); 
-}
+    template<class T>
+    WritePlan<T> prepare_write(const Dataspace &memspace, const Dataspace &filespace, const Properties &xfer);
 
-#ifdef HDF_WRAPPER_HAS_BOOST
-inline boost::optional<Dataset> Group::try_open_dataset(const std::string &name)
-{
-  hid_t id;
-  {
-    AutoErrorReportingGuard guard;
-    guard.disableReporting();
-    id = H5Dopen2(this->id, name.c_str(), H5P_DEFAULT);
-  }
-  if (id < 0) 
-  {
-    if (exists(name)) // well so the dataset exists but for some reason it cannot be opened -> error
-      throw Exception("unable to open existing item as dataset: "+name);
-    else
-      return boost::optional<Dataset>(); // no dataset under this name
-  }
-  else return boost::optional<Dataset>(Dataset(id, internal::NoIncRC()));
-}
-#endif
+    template<class T>
+    ReadPlan<T> prepare_read(const Dataspace &memspace, const Dataspace &filespace) const;
 
+    template<class T>
+    ReadPlan<T> prepare_read(const Dataspace &memspace, const Dataspace &filespace, const Properties &xfer) const;
 
+    template<class T>
+    void read(T *data) const
+    {
+      Dataspace ds = get_dataspace();
+      read(ds, H5S_ALL, data);
+    }
 
+    template<class T>
+    void read(const Dataspace &mem_space, const Dataspace &file_space, T* data) const
+    {
+      read(mem_space, file_space.get_id(), data);
+    }
 
-namespace internal
-{
+    template<class T>
+    void read(T *data, const Properties &xfer) const
+    {
+      Dataspace ds = get_dataspace();
+      read(ds, H5S_ALL, data, &xfer);
+    }
 
-/* This section deals with creation of Datatype objects for basic data types.
-   Copy is used on HDF API constants like "H5T_NATIVE_INT" because Datatype
-   object cannot handle these constants. This is because H5T_NATIVE_INT, etc.
-   are apparently not real objects, i.e. H5O_isvalid indicates false. Some special
-   case handling for these constants might be needed instead.
-*/
-template<class T>
-inline Datatype get_memtype()
-{
-  // writing sizeof(T)==0 seems to work for gcc. just writing false always causes an error????!
-  static_assert (sizeof(T)==0, "specialize me!");
-  return Datatype();
-}
+    template<class T>
+    void read(const Dataspace &mem_space, const Dataspace &file_space, T* data, const Properties &xfer) const
+    {
+      read(mem_space, file_space.get_id(), data, &xfer);
+    }
 
-template<class T>
-inline Datatype get_disktype()
-{
-  static_assert (sizeof(T)==0, "specialize me!");
-  return Datatype();
-}
+    // does not throw. ec is set to ERROR_LIBRARY on errors
+    template<class T>
+    void read(T *data, std::error_code &ec) const
+    {
+      read(data, Properties(), ec);
+    }
 
+    template<class T>
+    void read(T *data, const Properties &xfer, std::error_code &ec) const
+    {
+      ec.clear();
+      hid_t space_id = H5Dget_space(this->id);
+      if (space_id < 0)
+      {
+        ec = make_error_code(ERROR_LIBRARY);
+        return;
+      }
+      Dataspace memspace(space_id, internal::NoIncRC());
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+      RWdataset rw(get_id(), memtype.get_id(), H5S_ALL, H5S_ALL, transfer_id(xfer), &ec);
+      h5traits_of<T>::type::read(rw, memtype, memspace, data);
+    }
 
-#define HDF5_WRAPPER_SPECIALIZE_TYPE(T, tid, dtid) \
-template<> inline Datatype get_memtype<T>() \
-{ \
-  return Datatype::copy(tid); \
-} \
-template<> inline Datatype get_disktype<T>()  \
-{ \
-  return Datatype::copy(dtid); \
-}
+    /*
+      Reads the dataset into a block of a larger array. The shape of the block must equal that
+      of the dataset. array points to the first element of the whole array.
+    */
+    template<class T>
+    void read(const ArrayBlock &block, T *array) const
+    {
+      check_block_shape(block);
+      read(block.get_space(), H5S_ALL, array);
+    }
 
+    // reads the selection in file_space into the block, which must have as many elements
+    template<class T>
+    void read(const ArrayBlock &block, const Dataspace &file_space, T *array) const
+    {
+      read(block.get_space(), file_space.get_id(), array);
+    }
 
-HDF5_WRAPPER_SPECIALIZE_TYPE(int, H5T_NATIVE_INT, H5T_STD_I32LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned int, H5T_NATIVE_UINT, H5T_STD_U32LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned long long, H5T_NATIVE_ULLONG, H5T_STD_U64LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(long long, H5T_NATIVE_LLONG, H5T_STD_I64LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(char, H5T_NATIVE_CHAR, H5T_STD_I8LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned char, H5T_NATIVE_UCHAR, H5T_STD_U8LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(float, H5T_NATIVE_FLOAT, H5T_IEEE_F32LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(double, H5T_NATIVE_DOUBLE, H5T_IEEE_F64LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(bool, H5T_NATIVE_CHAR, H5T_STD_U8LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned long, H5T_NATIVE_ULONG, H5T_STD_U64LE)
-HDF5_WRAPPER_SPECIALIZE_TYPE(long, H5T_NATIVE_LONG, H5T_STD_I64LE)
+    template<class T>
+    void read(const ArrayBlock &block, T *array, const Properties &xfer) const
+    {
+      check_block_shape(block);
+      read(block.get_space(), H5S_ALL, array, &xfer);
+    }
 
+    template<class T>
+    void read(const ArrayBlock &block, const Dataspace &file_space, T *array, const Properties &xfer) const
+    {
+      read(block.get_space(), file_space.get_id(), array, &xfer);
+    }
 
-template<> inline Datatype get_memtype<const char *>()
-{
-  Datatype dt = Datatype::copy(H5T_C_S1);
-  dt.set_variable_size();
-  return dt;
-}
-template<> inline Datatype get_disktype<const char *>()
-{
-  return get_memtype<const char*>();
-}
+    // reads with an explicitly given memory type, which describes the layout of the buffer
+    void read(const Datatype &memtype, void *data) const
+    {
+      RWdataset rw(get_id(), memtype.get_id(), H5S_ALL, H5S_ALL);
+      rw.read(data);
+    }
 
-template<> inline Datatype get_memtype<char*>()
-{
-  return get_memtype<const char*>();
-}
+    // as above, with a transfer property list, e.g. VlenArena::transfer_properties
+    void read(const Datatype &memtype, void *data, const Properties &xfer_plist) const
+    {
+      RWdataset rw(get_id(), memtype.get_id(), H5S_ALL, H5S_ALL, transfer_id(xfer_plist));
+      rw.read(data);
+    }
 
-template<> inline Datatype get_disktype<char *>()
-{
-  return get_memtype<char*>();
-}
+    void read(const Datatype &memtype, const Dataspace &mem_space, const Dataspace &file_space, void *data) const
+    {
+      read(memtype, mem_space, file_space, data, Properties());
+    }
 
-} // namespace internal
+    void read(const Datatype &memtype, const Dataspace &mem_space, const Dataspace &file_space, void *data, const Properties &xfer_plist) const
+    {
+      RWdataset rw(get_id(), memtype.get_id(), mem_space.get_id(), file_space.get_id(), transfer_id(xfer_plist));
+      rw.read(data);
+    }
 
+    // writes the dataset from a block of a larger array, see read(const ArrayBlock&, T*)
+    template<class T>
+    void write(const ArrayBlock &block, const T *array)
+    {
+      check_block_shape(block);
+      write(block.get_space(), H5S_ALL, array);
+    }
 
+    template<class T>
+    void write(const ArrayBlock &block, const Dataspace &file_space, const T *array)
+    {
+      write(block.get_space(), file_space.get_id(), array);
+    }
 
+    template<class T>
+    void write(const ArrayBlock &block, const T *array, const Properties &xfer)
+    {
+      check_block_shape(block);
+      write(block.get_space(), H5S_ALL, array, &xfer);
+    }
 
-template<class T>
-struct h5traits
-{
-  static inline Datatype get_memtype()
-  {
-    return internal::get_memtype<T>();
-  }
+    template<class T>
+    void write(const ArrayBlock &block, const Dataspace &file_space, const T *array, const Properties &xfer)
+    {
+      write(block.get_space(), file_space.get_id(), array, &xfer);
+    }
+
+    void write(const Datatype &memtype, const void *data)
+    {
+      write(memtype, data, Properties());
+    }
+
+    void write(const Datatype &memtype, const void *data, const Properties &xfer_plist)
+    {
+      RWdataset rw(get_id(), memtype.get_id(), H5S_ALL, H5S_ALL, transfer_id(xfer_plist));
+      rw.write(data);
+    }
+
+    void write(const Datatype &memtype, const Dataspace &mem_space, const Dataspace &file_space, const void *data)
+    {
+      write(memtype, mem_space, file_space, data, Properties());
+    }
+
+    void write(const Datatype &memtype, const Dataspace &mem_space, const Dataspace &file_space, const void *data, const Properties &xfer_plist)
+    {
+      RWdataset rw(get_id(), memtype.get_id(), mem_space.get_id(), file_space.get_id(), transfer_id(xfer_plist));
+      rw.write(data);
+    }
+};
+
+
+
+
+
+namespace internal
+{
+// the state shared by ReadPlan and WritePlan
+class IOPlanBase
+{
+  protected:
+    Dataset ds;
+    Dataspace memspace, filespace;
+    Properties xfer;
+    hid_t memtype_id, xfer_id;
+
+    IOPlanBase(const Dataset &ds_, const Dataspace &memspace_, const Dataspace &filespace_, const Datatype &memtype, const Properties &xfer_) :
+      ds(ds_), memspace(memspace_.copy()), filespace(filespace_.copy()), xfer(xfer_), memtype_id(memtype.get_id()),
+      xfer_id(xfer_.get_id() < 0 ? H5P_DEFAULT : xfer_.get_id())
+    {
+      if (memspace.get_select_npoints() != filespace.get_select_npoints())
+        throw Exception("memory and file selections differ in size");
+    }
+
+  public:
+    /*
+      Shifts the file selection by offset elements per dimension, relative to where it
+      was selected when the plan was made.
+    */
+    void move_to(const hssize_t *offset)
+    {
+      if (H5Soffset_simple(filespace.get_id(), offset) < 0)
+        throw Exception("unable to move selection");
+    }
+
+    const Dataset& get_dataset() const { return ds; }
+};
+}
+
+
+/*
+  A write of a fixed selection shape, which resolves the types and dataspaces once.
+  Each execution is a single H5Dwrite without allocations or reference counting. Meant for
+  writing many slabs of the same shape, moving the selection in between with move_to.
+  Restricted to types whose values are transferred as they are in memory (not std::string).
+  The plan keeps the dataset open.
+*/
+template<class T>
+class WritePlan : public internal::IOPlanBase
+{
+    static_assert(std::is_pod<T>::value, "prepared I/O requires plain data types");
+    friend class Dataset;
+    WritePlan(const Dataset &ds_, const Dataspace &memspace_, const Dataspace &filespace_, const Properties &xfer_) :
+      IOPlanBase(ds_, memspace_, filespace_, internal::TypeRegistry<T>::memtype(), xfer_) {}
+
+  public:
+    void execute(const T *data)
+    {
+      if (H5Dwrite(ds.get_id(), memtype_id, memspace.get_id(), filespace.get_id(), xfer_id, data) < 0)
+        throw Exception("error writing to dataset");
+    }
+
+    void execute_at(const hssize_t *offset, const T *data)
+    {
+      move_to(offset);
+      execute(data);
+    }
+};
+
+
+// the counterpart of WritePlan
+template<class T>
+class ReadPlan : public internal::IOPlanBase
+{
+    static_assert(std::is_pod<T>::value, "prepared I/O requires plain data types");
+    friend class Dataset;
+    ReadPlan(const Dataset &ds_, const Dataspace &memspace_, const Dataspace &filespace_, const Properties &xfer_) :
+      IOPlanBase(ds_, memspace_, filespace_, internal::TypeRegistry<T>::memtype(), xfer_) {}
+
+  public:
+    void execute(T *data) const
+    {
+      if (H5Dread(ds.get_id(), memtype_id, memspace.get_id(), filespace.get_id(), xfer_id, data) < 0)
+        throw Exception("error reading from dataset");
+    }
+
+    void execute_at(const hssize_t *offset, T *data)
+    {
+      move_to(offset);
+      execute(data);
+    }
+};
+
+
+template<class T>
+inline WritePlan<T> Dataset::prepare_write(const Dataspace &memspace, const Dataspace &filespace)
+{
+  return WritePlan<T>(*this, memspace, filespace, Properties());
+}
+
+template<class T>
+inline WritePlan<T> Dataset::prepare_write(const Dataspace &memspace, const Dataspace &filespace, const Properties &xfer)
+{
+  return WritePlan<T>(*this, memspace, filespace, xfer);
+}
+
+template<class T>
+inline ReadPlan<T> Dataset::prepare_read(const Dataspace &memspace, const Dataspace &filespace) const
+{
+  return ReadPlan<T>(*this, memspace, filespace, Properties());
+}
+
+template<class T>
+inline ReadPlan<T> Dataset::prepare_read(const Dataspace &memspace, const Dataspace &filespace, const Properties &xfer) const
+{
+  return ReadPlan<T>(*this, memspace, filespace, xfer);
+}
+
+
+#ifdef HDF_WRAPPER_HAS_MMAP
+template<class T>
+inline MappedArray<T> Dataset::map() const
+{
+  Properties dcpl = get_creation_properties();
+  if (dcpl.get_layout() != H5D_CONTIGUOUS)
+    throw Exception("only datasets with contiguous layout can be mapped");
+  if (dcpl.get_nfilters() > 0)
+    throw Exception("filtered datasets cannot be mapped");
+  const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+  if (memtype.is_variable_length() || !get_datatype().is_equal(memtype))
+    throw Exception("datasets can only be mapped if the type on disk equals the memory type");
+
+  MappedArray<T> view;
+  view.file = get_file();
+  hid_t fapl = H5Fget_access_plist(view.file.get_id());
+  if (fapl < 0)
+    throw Exception("unable to get access properties of file");
+  hid_t driver = H5Pget_driver(fapl);
+  H5Pclose(fapl);
+  if (driver != H5FD_SEC2)
+    throw Exception("only datasets in files using the sec2 driver can be mapped");
+
+  Dataspace sp = get_dataspace();
+  view.rank = sp.get_dims(view.dims);
+  view.npoints = 1;
+  for (int i = 0; i < view.rank; ++i)
+    view.npoints *= view.dims[i];
+  if (view.npoints == 0)
+    return view;
+  if (!view.file.is_readonly())
+    view.file.flush(); // the data may still be in the library's caches
+  haddr_t offset = H5Dget_offset(this->id);
+  if (offset == HADDR_UNDEF)
+    throw Exception("storage of dataset is not allocated");
+  if (offset % std::alignment_of<T>::value != 0)
+    throw Exception("dataset storage is not aligned for mapping, see Properties::alignment");
+  view.mapping = std::make_shared<internal::FileMapping>(view.file.get_file_name(), offset, size_t(view.npoints * sizeof(T)));
+  view.ptr = reinterpret_cast<const T*>(view.mapping->get_data());
+  return view;
+}
+#endif
+
+
+inline Dataset Group::open_dataset(const std::string &name)
+{
+  return Dataset(this->id, name, H5P_DEFAULT, internal::TagOpen()); 
+}
+
+inline Dataset Group::open_dataset(const std::string &name, std::error_code &ec)
+{
+  Dataset ds;
+  if (exists(name, ec))
+  {
+    ds.id = H5Dopen2(this->id, name.c_str(), H5P_DEFAULT);
+    if (ds.id < 0) ec = make_error_code(ERROR_LIBRARY);
+  }
+  else if (!ec)
+    ec = make_error_code(ERROR_NOT_FOUND);
+  return ds;
+}
+
+inline Dataset Group::open_dataset(const std::string &name, const ChunkCache &cache)
+{
+  size_t nbytes = cache.nbytes, nslots = cache.nslots;
+  hsize_t cdims[H5S_MAX_RANK];
+  int r = 0;
+  size_t chunk_nbytes = 0;
+  if (cache.automatic || nslots == 0)
+  { // need to look at the chunks first. the dataset must be closed again before the cache can be configured.
+    Dataset ds = open_dataset(name);
+    r = ds.get_creation_properties().get_chunk(cdims);
+    chunk_nbytes = ds.get_datatype().get_size();
+    for (int i = 0; i < r; ++i)
+      chunk_nbytes *= cdims[i];
+    if (r > 0 && cache.automatic)
+    {
+      hsize_t dims[H5S_MAX_RANK], sel[H5S_MAX_RANK];
+      ds.get_dataspace().get_dims(dims);
+      for (int i = 0; i < r; ++i)
+      {
+        if (cache.rank == r) sel[i] = cache.selection_dims[i];
+        else sel[i] = (i == 0) ? cdims[0] : dims[i];
+      }
+      nbytes = chunk_nbytes;
+      for (int i = 0; i < r; ++i)
+      { // the number of chunks a selection of this size may intersect
+        hsize_t n = sel[i] > 0 ? (sel[i] - 1) / cdims[i] + 2 : 1;
+        hsize_t total = (dims[i] + cdims[i] - 1) / cdims[i];
+        if (n > total && total > 0) n = total;
+        nbytes *= n;
+      }
+      if (nbytes > cache.nbytes) nbytes = cache.nbytes;
+      if (nbytes < chunk_nbytes) nbytes = chunk_nbytes;
+    }
+  }
+  if (nslots == 0)
+  {
+    size_t nchunks = chunk_nbytes > 0 ? nbytes / chunk_nbytes : 0;
+    nslots = internal::next_prime(100 * (nchunks > 0 ? nchunks : 1));
+  }
+  Properties dapl(H5P_DATASET_ACCESS);
+  if (H5Pset_chunk_cache(dapl.get_id(), nslots, nbytes, cache.w0) < 0)
+    throw Exception("unable to set chunk cache parameters");
+  return Dataset(this->id, name, dapl.get_id(), internal::TagOpen());
+}
+
+#ifdef HDF_WRAPPER_HAS_BOOST
+inline boost::optional<Dataset> Group::try_open_dataset(const std::string &name)
+{
+  hid_t id;
+  {
+    AutoErrorReportingGuard guard;
+    guard.disableReporting();
+    id = H5Dopen2(this->id, name.c_str(), H5P_DEFAULT);
+  }
+  if (id < 0) 
+  {
+    if (exists(name)) // well so the dataset exists but for some reason it cannot be opened -> error
+      throw Exception("unable to open existing item as dataset: "+name);
+    else
+      return boost::optional<Dataset>(); // no dataset under this name
+  }
+  else return boost::optional<Dataset>(Dataset(id, internal::NoIncRC()));
+}
+#endif
+
+
+
+
+namespace internal
+{
+
+/* This section deals with creation of Datatype objects for basic data types.
+   Copy is used on HDF API constants like "H5T_NATIVE_INT" because Datatype
+   object cannot handle these constants. This is because H5T_NATIVE_INT, etc.
+   are apparently not real objects, i.e. H5O_isvalid indicates false. Some special
+   case handling for these constants might be needed instead.
+*/
+template<class T>
+inline Datatype get_memtype()
+{
+  // writing sizeof(T)==0 seems to work for gcc. just writing false always causes an error????!
+  static_assert (sizeof(T)==0, "specialize me!");
+  return Datatype();
+}
+
+template<class T>
+inline Datatype get_disktype()
+{
+  static_assert (sizeof(T)==0, "specialize me!");
+  return Datatype();
+}
+
+
+#define HDF5_WRAPPER_SPECIALIZE_TYPE(T, tid, dtid) \
+template<> inline Datatype get_memtype<T>() \
+{ \
+  return Datatype::copy(tid); \
+} \
+template<> inline Datatype get_disktype<T>()  \
+{ \
+  return Datatype::copy(dtid); \
+}
+
+
+HDF5_WRAPPER_SPECIALIZE_TYPE(int, H5T_NATIVE_INT, H5T_STD_I32LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned int, H5T_NATIVE_UINT, H5T_STD_U32LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned long long, H5T_NATIVE_ULLONG, H5T_STD_U64LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(long long, H5T_NATIVE_LLONG, H5T_STD_I64LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(char, H5T_NATIVE_CHAR, H5T_STD_I8LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned char, H5T_NATIVE_UCHAR, H5T_STD_U8LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(float, H5T_NATIVE_FLOAT, H5T_IEEE_F32LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(double, H5T_NATIVE_DOUBLE, H5T_IEEE_F64LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(bool, H5T_NATIVE_UCHAR, H5T_STD_U8LE) // unsigned like the disk type, avoids a conversion pass
+HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned long, H5T_NATIVE_ULONG, H5T_STD_U64LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(long, H5T_NATIVE_LONG, H5T_STD_I64LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(short, H5T_NATIVE_SHORT, H5T_STD_I16LE)
+HDF5_WRAPPER_SPECIALIZE_TYPE(unsigned short, H5T_NATIVE_USHORT, H5T_STD_U16LE)
+
+
+template<> inline Datatype get_memtype<const char *>()
+{
+  Datatype dt = Datatype::copy(H5T_C_S1);
+  dt.set_variable_size();
+  return dt;
+}
+template<> inline Datatype get_disktype<const char *>()
+{
+  return get_memtype<const char*>();
+}
+
+template<> inline Datatype get_memtype<char*>()
+{
+  return get_memtype<const char*>();
+}
+
+template<> inline Datatype get_disktype<char *>()
+{
+  return get_memtype<char*>();
+}
+
+} // namespace internal
+
+
+
+
+template<class T>
+struct h5traits
+{
+  static inline Datatype get_memtype()
+  {
+    return internal::get_memtype<T>();
+  }
 
   static inline Datatype get_disktype()
   {
@@ -1324,13 +3125,40 @@ struct h5traits<std::string>
 
     std::vector<char*> buffers(n);
     rw.read(&buffers[0]);
-    for (hssize_t i = 0; i < n; ++i)
+    if (memspace.get_selection_type() == H5S_SEL_ALL)
+    {
+      for (hssize_t i = 0; i < n; ++i)
+        assign(values[i], buffers[i]);
+    }
+    else // leave the strings outside of the selection alone, e.g. around an ArrayBlock
     {
-      values[i].assign(buffers[i]);
+      Selected selected = { &buffers[0], values };
+      if (H5Diterate(&buffers[0], memtype.get_id(), memspace.get_id(), &assign_selected, &selected) < 0)
+        throw Exception("error iterating over selected strings");
     }
     // release the stuff that hdf5 allocated
     H5Dvlen_reclaim(memtype.get_id(), memspace.get_id(), H5P_DEFAULT, &buffers[0]);
   }
+
+  struct Selected
+  {
+    char **buffers;
+    std::string *values;
+  };
+
+  static inline void assign(std::string &value, const char *buffer)
+  {
+    if (buffer) value.assign(buffer);
+    else value.clear(); // a null string, or the read failed
+  }
+
+  static herr_t assign_selected(void *elem, hid_t, unsigned, const hsize_t *, void *op_data)
+  {
+    Selected &s = *static_cast<Selected*>(op_data);
+    char **buffer = static_cast<char**>(elem);
+    assign(s.values[buffer - s.buffers], *buffer);
+    return 0;
+  }
 };
 
 
@@ -1389,44 +3217,266 @@ struct h5traits_of
 
 
 /*
-Here is this super ugly code which caches the result of the construction of HDF5 
-types in static, i.e. global variables. The mechanism uses hid_t as static
-variable type, because using Datatype would result in destructor calls,
-and concomitant api calls when the hdf lib is unloaded already.
+  Compound types. Structs are mapped to HDF5 compound types by listing their members:
+
+    HDF5_WRAPPER_COMPOUND_BEGIN(Particle)
+      HDF5_WRAPPER_COMPOUND_MEMBER(x)
+      HDF5_WRAPPER_COMPOUND_MEMBER(id)
+    HDF5_WRAPPER_COMPOUND_END()
+
+  at global namespace scope. Afterwards Particle works like the predefined types, e.g.
+  create_dataset(group, name, std::vector<Particle>(...)). Members can be of any mapped type, including
+  other compounds, char[n] (fixed length strings) and arrays.
+  The memory type has the native layout of the struct (which must be standard layout because offsetof is used)
+  while the disk type is packed, with members in the order of registration.
 */
-namespace internal
-{
+template<class T>
+struct compound_members; // specialized by HDF5_WRAPPER_COMPOUND_BEGIN. Has visit(V &v), which calls v(name, offset, &T::member) for each member.
 
-inline hid_t prep_type_cache(Datatype dt)
-{
-  dt.lock();
-  dt.inc_ref();
-  return dt.get_id();
-}
+#define HDF5_WRAPPER_COMPOUND_BEGIN(T) \
+namespace h5cpp { \
+template<> struct h5traits<T> : internal::compound_h5traits<T> {}; \
+template<> struct compound_members<T> \
+{ \
+  typedef T type; \
+  template<class V> static void visit(V &v) \
+  {
+
+#define HDF5_WRAPPER_COMPOUND_MEMBER(m) \
+    v(#m, offsetof(type, m), &type::m);
 
+#define HDF5_WRAPPER_COMPOUND_END() \
+  } \
+}; \
 }
 
-// wrap complicated things in neat api functions
-template<class T>
-inline Datatype get_disktype()
+namespace internal
 {
-  static hid_t id = internal::prep_type_cache(h5traits_of<T>::type::get_disktype());
-  return Datatype(id, internal::IncRC());
-}
 
-template<class T>
-inline Datatype get_memtype()
+// types of compound members
+template<class M>
+struct compound_member_type
 {
-  static hid_t id = internal::prep_type_cache(h5traits_of<T>::type::get_memtype());
-  return Datatype(id, internal::IncRC());
-}
+  static Datatype memtype() { return TypeRegistry<M>::memtype(); }
+  static Datatype disktype() { return TypeRegistry<M>::disktype(); }
+};
 
-} // namespace h5cpp
+template<class M, size_t n>
+struct compound_member_type<M[n]>
+{
+  static Datatype memtype() { return array_of(compound_member_type<M>::memtype()); }
+  static Datatype disktype() { return array_of(compound_member_type<M>::disktype()); }
+  static Datatype array_of(const Datatype &base)
+  {
+    int dims[1] = { (int)n };
+    return Datatype::createArray(base, 1, dims);
+  }
+};
 
+template<size_t n>
+struct compound_member_type<char[n]>
+{
+  static Datatype memtype() { return Datatype::fixed_string(n); }
+  static Datatype disktype() { return Datatype::fixed_string(n); }
+};
 
+// not possible, use char[n]. Variable length strings would be allocated by the library on read and
+// could not be released without knowing every struct that received them.
+template<>
+struct compound_member_type<std::string>;
+template<>
+struct compound_member_type<const char*>;
+template<>
+struct compound_member_type<char*>;
 
-namespace h5cpp
-{
+
+template<class T>
+class CompoundBuilder
+{
+    hid_t id;
+    bool disk;
+    size_t disk_offset;
+  public:
+    CompoundBuilder(hid_t id_, bool disk_) : id(id_), disk(disk_), disk_offset(0) {}
+
+    template<class M>
+    void operator()(const char *name, size_t offset, M T::*)
+    {
+      Datatype dt = disk ? compound_member_type<M>::disktype() : compound_member_type<M>::memtype();
+      if (id >= 0 && H5Tinsert(id, name, disk ? disk_offset : offset, dt.get_id()) < 0)
+        throw Exception(std::string("error inserting compound member ")+name);
+      disk_offset += dt.get_size();
+    }
+
+    size_t get_packed_size() const { return disk_offset; }
+};
+
+
+template<class T>
+struct compound_h5traits
+{
+  static inline Datatype get_memtype()
+  {
+    Datatype dt = create(sizeof(T));
+    CompoundBuilder<T> builder(dt.get_id(), false);
+    compound_members<T>::visit(builder);
+    return dt;
+  }
+
+  static inline Datatype get_disktype()
+  {
+    CompoundBuilder<T> sizer(-1, true); // first pass determines the size
+    compound_members<T>::visit(sizer);
+    Datatype dt = create(sizer.get_packed_size());
+    CompoundBuilder<T> builder(dt.get_id(), true);
+    compound_members<T>::visit(builder);
+    return dt;
+  }
+
+  static inline void write(RW &rw, const Datatype &memtype, const Dataspace &memspace, const T *values)
+  {
+    rw.write(values);
+  }
+
+  static inline void read(RW &rw, const Datatype &memtype, const Dataspace &memspace, T *values)
+  {
+    rw.read(values);
+  }
+
+  static inline Datatype create(size_t size)
+  {
+    hid_t id = H5Tcreate(H5T_COMPOUND, size);
+    if (id < 0)
+      throw Exception("error creating compound type");
+    return Datatype(id, internal::NoIncRC());
+  }
+};
+
+} // namespace internal
+
+
+/*
+Here is this super ugly code which caches the result of the construction of HDF5 
+types in static, i.e. global variables. The cached Datatype instances are allocated
+on the heap and never deleted, because destructors of static objects would result
+in api calls when the hdf lib is unloaded already.
+
+The initialization of function local statics is thread safe since C++11 (MSVC 2015),
+and afterwards a lookup is a plain load without locking and without calls into the
+library. Since the first use of each type still calls into the library, multithreaded
+programs should create the types they need up front, see init_type_registry.
+*/
+namespace internal
+{
+
+// sets the byte order of numbers, also those in compound and array types. other types are returned as they are
+inline Datatype with_byte_order(Datatype dt, H5T_order_t order)
+{
+  if (dt.get_size() == 1) // the order would only make the library convert single bytes
+    return dt;
+  if (H5Tdetect_class(dt.get_id(), H5T_ENUM) > 0) // the library refuses to change enums which have members
+    return dt;
+  switch (H5Tget_class(dt.get_id()))
+  {
+    case H5T_INTEGER:
+    case H5T_FLOAT:
+    case H5T_BITFIELD:
+    case H5T_COMPOUND:
+    case H5T_ARRAY:
+      if (H5Tset_order(dt.get_id(), order) < 0)
+        throw Exception("unable to set byte order of datatype");
+      return dt;
+    default:
+      return dt;
+  }
+}
+
+inline hid_t prep_type_cache(Datatype dt)
+{
+  dt.lock();
+  dt.inc_ref();
+  return dt.get_id();
+}
+
+template<class T>
+struct TypeRegistry
+{
+  static const Datatype& memtype()
+  {
+    static const Datatype *dt = new Datatype(prep_type_cache(h5traits_of<T>::type::get_memtype()));
+    return *dt;
+  }
+
+  static const Datatype& disktype()
+  {
+    static const Datatype *dt = new Datatype(prep_type_cache(h5traits_of<T>::type::get_disktype()));
+    return *dt;
+  }
+
+  // the disk type with numbers in the given byte order. the plain disk type is little endian
+  static const Datatype& disktype(H5T_order_t order)
+  {
+    if (order != H5T_ORDER_BE)
+      return disktype();
+    static const Datatype *dt = new Datatype(prep_type_cache(with_byte_order(h5traits_of<T>::type::get_disktype(), H5T_ORDER_BE)));
+    return *dt;
+  }
+};
+
+
+}
+
+// wrap complicated things in neat api functions
+template<class T>
+inline Datatype get_disktype()
+{
+  return internal::TypeRegistry<T>::disktype();
+}
+
+template<class T>
+inline Datatype get_memtype()
+{
+  return internal::TypeRegistry<T>::memtype();
+}
+
+// creates and caches the memory and disk types of T, if not done already
+template<class T>
+inline void register_type()
+{
+  internal::TypeRegistry<T>::memtype();
+  internal::TypeRegistry<T>::disktype();
+}
+
+/*
+  Creates the cached types of the predefined mappings. Call before starting threads
+  which use the library, and call register_type for other types these threads use.
+*/
+inline void init_type_registry()
+{
+  register_type<int>();
+  register_type<unsigned int>();
+  register_type<unsigned long long>();
+  register_type<long long>();
+  register_type<char>();
+  register_type<unsigned char>();
+  register_type<float>();
+  register_type<double>();
+  register_type<bool>();
+  register_type<unsigned long>();
+  register_type<long>();
+  register_type<short>();
+  register_type<unsigned short>();
+  register_type<std::string>();
+  register_type<const char*>();
+  register_type<char*>();
+}
+
+} // namespace h5cpp
+
+
+
+namespace h5cpp
+{
 
 /*==================================================
 *          some free functions
@@ -1465,6 +3515,193 @@ inline void get_dims(const Dataspace &sp, std::vector<T, A> &ret)
   std::copy(dims, dims + r, ret.begin());
 }
 #endif
+/*--------------------------------------------------
+*            fixed length strings
+* ------------------------------------------------ */
+
+// a non-owning reference to a string which is not necessarily null terminated
+struct StringRef
+{
+  const char *ptr;
+  size_t len;
+
+  StringRef() : ptr(NULL), len(0) {}
+  StringRef(const char *ptr_, size_t len_) : ptr(ptr_), len(len_) {}
+
+  std::string str() const { return std::string(ptr, len); }
+  size_t size() const { return len; }
+  const char* begin() const { return ptr; }
+  const char* end() const { return ptr + len; }
+  bool operator==(const StringRef &other) const { return len == other.len && std::memcmp(ptr, other.ptr, len) == 0; }
+  bool operator!=(const StringRef &other) const { return !(*this == other); }
+  bool operator==(const std::string &other) const { return *this == StringRef(other.data(), other.size()); }
+  bool operator!=(const std::string &other) const { return !(*this == other); }
+};
+
+inline std::ostream& operator<<(std::ostream &os, const StringRef &s)
+{
+  return os.write(s.ptr, s.len);
+}
+
+
+/*
+  Strings of a fixed width, stored contiguously. Datasets and attributes with fixed length
+  strings are read and written in one piece, whereas variable length strings require one
+  heap allocation per element, in the library and for the std::string.
+  Elements shorter than the width are padded with zeros, longer ones are truncated.
+*/
+class FixedStrings
+{
+    std::vector<char> buffer;
+    size_t width;
+
+  public:
+    FixedStrings() : width(1) {}
+    FixedStrings(size_t n, size_t width_) : buffer(n * width_, 0), width(width_) { assert(width > 0); }
+
+    // width = 0 means that the width is the length of the longest string
+    template<class A>
+    explicit FixedStrings(const std::vector<std::string, A> &strings, size_t width_ = 0) : width(width_)
+    {
+      if (width == 0)
+      {
+        width = 1; // the library does not permit zero size strings
+        for (size_t i = 0; i < strings.size(); ++i)
+          width = std::max(width, strings[i].size());
+      }
+      buffer.resize(strings.size() * width, 0);
+      for (size_t i = 0; i < strings.size(); ++i)
+        set(i, strings[i]);
+    }
+
+    void resize(size_t n, size_t width_)
+    {
+      assert(width_ > 0);
+      width = width_;
+      buffer.assign(n * width, 0);
+    }
+
+    size_t size() const { return buffer.size() / width; }
+    size_t get_width() const { return width; }
+    char* data() { return buffer.empty() ? NULL : &buffer[0]; }
+    const char* data() const { return buffer.empty() ? NULL : &buffer[0]; }
+
+    StringRef operator[](size_t i) const
+    {
+      const char *p = &buffer[i * width];
+      size_t len = 0;
+      while (len < width && p[len] != 0) ++len;
+      return StringRef(p, len);
+    }
+
+    std::string str(size_t i) const { return (*this)[i].str(); }
+
+    void set(size_t i, const std::string &s)
+    {
+      char *p = &buffer[i * width];
+      size_t len = std::min(s.size(), width);
+      std::memcpy(p, s.data(), len);
+      std::memset(p + len, 0, width - len);
+    }
+
+    template<class A>
+    void to_strings(std::vector<std::string, A> &ret) const
+    {
+      ret.resize(size());
+      for (size_t i = 0; i < ret.size(); ++i)
+      {
+        StringRef r = (*this)[i];
+        ret[i].assign(r.ptr, r.len);
+      }
+    }
+
+    // the type of the elements in memory, and the default type on disk
+    Datatype get_datatype() const { return Datatype::fixed_string(width); }
+};
+
+
+/*--------------------------------------------------
+*            variable length data in an arena
+* ------------------------------------------------ */
+
+/*
+  Bump allocator for variable length data read by the library. Installed through the transfer
+  property list (H5Pset_vlen_mem_manager), it replaces one malloc per element and the
+  H5Dvlen_reclaim afterwards. Memory is only released as a whole, by clear() or the destructor,
+  which invalidates all data read with the arena. Not thread safe: use one arena per thread.
+*/
+class VlenArena
+{
+    std::vector<std::unique_ptr<char[]> > blocks;
+    size_t block_size, used; // used bytes of the last block
+    size_t nallocs, nbytes;
+
+    VlenArena(const VlenArena&);
+    VlenArena& operator=(const VlenArena&);
+
+    static void* alloc_cb(size_t size, void *info)
+    {
+      try
+      {
+        return static_cast<VlenArena*>(info)->allocate(size);
+      }
+      catch (...)
+      {
+        return NULL; // called from a c library
+      }
+    }
+
+    static void free_cb(void *, void *) {} // released with the arena
+
+  public:
+    explicit VlenArena(size_t block_size_ = 1024*1024) : block_size(block_size_), used(block_size_), nallocs(0), nbytes(0) {}
+
+    void* allocate(size_t size)
+    {
+      const size_t align = 16;
+      size = (size + align - 1) / align * align;
+      ++nallocs;
+      nbytes += size;
+      if (size > block_size / 4) // large allocations get their own block, placed before the current one
+      {
+        std::unique_ptr<char[]> b(new char[size]);
+        char *p = b.get();
+        blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, std::move(b));
+        return p;
+      }
+      if (used + size > block_size)
+      {
+        blocks.push_back(std::unique_ptr<char[]>(new char[block_size]));
+        used = 0;
+      }
+      char *p = blocks.back().get() + used;
+      used += size;
+      return p;
+    }
+
+    // releases all memory
+    void clear()
+    {
+      blocks.clear();
+      used = block_size;
+      nallocs = nbytes = 0;
+    }
+
+    size_t get_allocations() const { return nallocs; }
+    size_t get_bytes() const { return nbytes; }
+    size_t get_blocks() const { return blocks.size(); }
+
+    // dataset transfer property list directing the allocations of variable length data to this arena
+    Properties transfer_properties()
+    {
+      Properties dxpl(H5P_DATASET_XFER);
+      if (H5Pset_vlen_mem_manager(dxpl.get_id(), &VlenArena::alloc_cb, this, &VlenArena::free_cb, this) < 0)
+        throw Exception("error setting vlen memory manager");
+      return dxpl;
+    }
+};
+
+
 /*--------------------------------------------------
 *            datasets
 * ------------------------------------------------ */
@@ -1472,76 +3709,2096 @@ inline void get_dims(const Dataspace &sp, std::vector<T, A> &ret)
 
 
 template<class T>
-inline Dataset create_dataset(Group group, const std::string &name, const Dataspace &sp, const T* data = nullptr, DsCreationFlags flags = CREATE_DS_DEFAULT)
+inline Dataset create_dataset(const Group &group, const std::string &name, const Dataspace &sp, const T* data = nullptr, DsCreationFlags flags = CREATE_DS_DEFAULT, AccessPattern pattern = ACCESS_ANY)
 {
-  Dataset ds = Dataset::create(group, name, get_disktype<T>(), sp, Dataset::create_creation_properties(sp, flags));
+  Dataset ds = Dataset::create<T>(group, name, sp, flags, pattern);
   if (data != nullptr)
     ds.write<T>(data);
   return ds;
 }
 
 template<class T>
-inline Dataset create_dataset_scalar(Group group, const std::string &name, const T& data)
+inline Dataset create_dataset_scalar(const Group &group, const std::string &name, const T& data)
 {
   Dataspace sp = Dataspace::scalar();
-  Dataset ds = Dataset::create(group, name, get_disktype<T>(), sp, Dataset::create_creation_properties(sp, CREATE_DS_0));
+  Dataset ds = Dataset::create(group, name, internal::TypeRegistry<T>::disktype(), sp, Dataset::create_creation_properties(sp, CREATE_DS_0));
   ds.write<T>(&data);
   return ds;
 }
 
 
 template<class T, class A>
-inline Dataset create_dataset(Group group, const std::string &name, const std::vector<T, A> &data, DsCreationFlags flags = CREATE_DS_DEFAULT)
+inline Dataset create_dataset(const Group &group, const std::string &name, const std::vector<T, A> &data, DsCreationFlags flags = CREATE_DS_DEFAULT)
 {
   return create_dataset(group, name, Dataspace::simple_dims(data.size()), &data[0], flags);
 }
 
 
 template<class T, class A>
-inline void read_dataset(const Dataset ds, std::vector<T, A> &ret)
+inline void read_dataset(const Dataset &ds, std::vector<T, A> &ret)
 {
   Dataspace sp = ds.get_dataspace();
   ret.resize(sp.get_npoints());
   ds.read(&ret[0]);
 }
 
+// with a transfer property list, see Properties::conversion_buffer
+template<class T, class A>
+inline void read_dataset(const Dataset &ds, std::vector<T, A> &ret, const Properties &xfer)
+{
+  Dataspace sp = ds.get_dataspace();
+  ret.resize(sp.get_npoints());
+  ds.read(&ret[0], xfer);
+}
+
 
-/*--------------------------------------------------
- *            Attributes
- * ------------------------------------------------ */
+namespace internal
+{
 
-template<class T, class A>
-inline void set_array(Attributes attrs, const std::string &name, const std::vector<T, A> &data)
+// one dimensional, also without strings
+inline Dataspace strings_space(const FixedStrings &data)
 {
-  attrs.set(name, Dataspace::simple_dims(data.size()), &data[0]);
+  hsize_t n = data.size(), maxdims = std::max<hsize_t>(n, 1); // H5Screate_simple does not like zero sized maximal dimensions
+  return Dataspace::simple(1, &n, &maxdims);
 }
 
-template<class T>
-inline void set_array(Attributes attrs, const std::string &name, const T* data, hsize_t count)
+// reads a dataset or attribute of fixed or variable length strings, see read_dataset(const Dataset&, FixedStrings&)
+template<class Source>
+inline void read_fixed_strings(const Source &src, FixedStrings &ret, const std::string &what)
 {
-  attrs.set(name, Dataspace::simple_dims(count), data);
+  Datatype disktype = src.get_datatype();
+  if (disktype.get_class() != H5T_STRING)
+    throw Exception(what + " does not contain strings");
+  hssize_t n = H5Sget_simple_extent_npoints(src.get_dataspace().get_id()); // unlike get_npoints, accepts empty extents
+  if (n < 0)
+    throw Exception("unable to determine number of elements in dataspace");
+  if (disktype.is_variable_length())
+  {
+    std::vector<std::string> tmp(n);
+    if (n > 0)
+      src.read(&tmp[0]);
+    ret = FixedStrings(tmp);
+    return;
+  }
+  Datatype memtype = Datatype::copy(disktype.get_id()); // keeps the character set
+  memtype.set_strpad(H5T_STR_NULLPAD);
+  ret.resize(n, memtype.get_size());
+  if (n > 0)
+    src.read(memtype, ret.data());
 }
 
-template<class T>
-inline void set(Attributes attrs, const std::string &name, const T &value)
+}
+
+// creates a one dimensional dataset of fixed length strings
+inline Dataset create_dataset(const Group &group, const std::string &name, const FixedStrings &data, DsCreationFlags flags = CREATE_DS_DEFAULT)
 {
-  attrs.set(name, Dataspace::scalar(), &value);
+  Dataspace sp = internal::strings_space(data);
+  Datatype dt = data.get_datatype();
+  Dataset ds = Dataset::create(group, name, dt, sp, Dataset::create_creation_properties(sp, flags, dt.get_size()));
+  if (data.size() > 0)
+    ds.write(dt, data.data());
+  return ds;
 }
 
-template<class T, class A>
-inline void get_array(Attributes attrs, const std::string &name, std::vector<T, A> &ret)
+/*
+  Reads strings into contiguous memory. The width is that of the strings on disk. Datasets
+  of variable length strings are supported, too, but the width is then determined by the
+  longest string and reading is not faster than reading into std::string.
+*/
+inline void read_dataset(const Dataset &ds, FixedStrings &ret)
 {
-  Attribute a = attrs.open(name);
-  ret.resize(a.get_dataspace().get_npoints());
-  a.read<T>(&ret[0]);
+  internal::read_fixed_strings(ds, ret, "dataset");
 }
 
-template<class T>
-inline void get(Attributes attrs, const std::string &name, T &value)
+/*
+  Reads variable length strings, placing the string data in the arena. The returned views remain valid
+  until the arena is cleared or destroyed. Null strings become empty views.
+  There is no such function for attributes, because H5Aread does not take a transfer property list.
+*/
+template<class A>
+inline void read_dataset(const Dataset &ds, VlenArena &arena, std::vector<StringRef, A> &ret)
 {
-  Attribute a = attrs.open(name);
-  assert(a.get_dataspace().get_npoints() == 1);
-  a.read<T>(&value);
+  Datatype memtype = ds.get_datatype(); // the copy keeps the character set
+  if (memtype.get_class() != H5T_STRING || !memtype.is_variable_length())
+    throw Exception("dataset does not contain variable length strings");
+  hssize_t n = ds.get_dataspace().get_npoints();
+  std::vector<char*> ptrs(n);
+  ds.read(memtype, &ptrs[0], arena.transfer_properties());
+  ret.resize(n);
+  for (hssize_t i = 0; i < n; ++i)
+    ret[i] = ptrs[i] ? StringRef(ptrs[i], std::strlen(ptrs[i])) : StringRef();
+}
+
+// reads datasets of variable and fixed length strings
+template<class A>
+inline void read_dataset(const Dataset &ds, std::vector<std::string, A> &ret)
+{
+  if (ds.get_datatype().is_fixed_string())
+  {
+    FixedStrings tmp;
+    read_dataset(ds, tmp);
+    tmp.to_strings(ret);
+    return;
+  }
+  ret.resize(ds.get_dataspace().get_npoints());
+  ds.read(&ret[0]);
+}
+
+
+/*--------------------------------------------------
+ *            selections
+ * ------------------------------------------------ */
+
+/*
+  A python like slice start:stop:step of one dimension. stop is exclusive. Negative start and
+  stop count from the end of the dimension. Slice(i) selects the single index i.
+*/
+struct Slice
+{
+  enum { END = std::numeric_limits<hssize_t>::max() };
+  hssize_t start, stop, step;
+
+  Slice(hssize_t index) : start(index), stop(index == -1 ? hssize_t(END) : index + 1), step(1) {}
+  Slice(hssize_t start_, hssize_t stop_, hssize_t step_ = 1) : start(start_), stop(stop_), step(step_) {}
+
+  static Slice all() { return Slice(0, END); }
+
+  // resolves the slice for a dimension of size n. returns false if nothing is selected
+  bool resolve(hsize_t n, hsize_t &offset, hsize_t &stride, hsize_t &count) const
+  {
+    if (step <= 0)
+      throw Exception("slice step must be positive");
+    hssize_t b = start < 0 ? start + hssize_t(n) : start;
+    hssize_t e = stop == hssize_t(END) ? hssize_t(n) : (stop < 0 ? stop + hssize_t(n) : std::min(stop, hssize_t(n)));
+    if (b < 0) b = 0;
+    if (e <= b)
+      return false;
+    offset = b;
+    stride = step;
+    count = (e - b + step - 1) / step;
+    return true;
+  }
+};
+
+
+/*
+  Builds a selection in the dataspace of a dataset from slices, unions and intersections of
+  hyperslabs, or points. HDF5 cannot mix hyperslabs and points in one selection.
+  The memory side is a one dimensional array of all selected elements, in row major order of
+  their coordinates in the file for hyperslabs and in the given order for points.
+  Reading or writing is one call into the library, regardless of the number of regions.
+  Example:
+    std::vector<float> values;
+    Selection(ds).add({ Slice(0, 10, 2), Slice::all() }).add({ -1, Slice(5, 8) }).read(ds, values);
+*/
+class Selection
+{
+    Dataspace space;
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+
+    // returns false if the hyperslab is empty
+    bool resolve(const std::vector<Slice> &slices, hsize_t *offset, hsize_t *stride, hsize_t *count) const
+    {
+      if (slices.size() != size_t(rank))
+        throw Exception("number of slices differs from rank of dataspace");
+      bool nonempty = true;
+      for (int i = 0; i < rank; ++i)
+        nonempty &= slices[i].resolve(dims[i], offset[i], stride[i], count[i]);
+      return nonempty;
+    }
+
+    static bool is_collective(const Properties &xfer)
+    {
+#ifdef H5_HAVE_PARALLEL
+      H5FD_mpio_xfer_t mode;
+      return xfer.get_id() >= 0 && H5Pget_dxpl_mpio(xfer.get_id(), &mode) >= 0 && mode == H5FD_MPIO_COLLECTIVE;
+#else
+      (void)xfer;
+      return false;
+#endif
+    }
+
+    Selection& combine(H5S_seloper_t op, const std::vector<Slice> &slices)
+    {
+      hsize_t offset[H5S_MAX_RANK], stride[H5S_MAX_RANK], count[H5S_MAX_RANK];
+      if (resolve(slices, offset, stride, count))
+        space.select_hyperslab(op, offset, stride, count, NULL);
+      else if (op == H5S_SELECT_SET || op == H5S_SELECT_AND)
+        space.select_none();
+      return *this;
+    }
+
+  public:
+    // starts with an empty selection in a copy of filespace
+    explicit Selection(const Dataspace &filespace) : space(filespace.copy())
+    {
+      rank = space.get_dims(dims);
+      space.select_none();
+    }
+
+    explicit Selection(const Dataset &ds) : space(ds.get_dataspace())
+    {
+      rank = space.get_dims(dims);
+      space.select_none();
+    }
+
+    // replaces the selection
+    Selection& set(const std::vector<Slice> &slices) { return combine(H5S_SELECT_SET, slices); }
+
+    // union
+    Selection& add(const std::vector<Slice> &slices) { return combine(H5S_SELECT_OR, slices); }
+
+    // intersection
+    Selection& intersect(const std::vector<Slice> &slices) { return combine(H5S_SELECT_AND, slices); }
+
+    // difference
+    Selection& subtract(const std::vector<Slice> &slices) { return combine(H5S_SELECT_NOTB, slices); }
+
+    // adds the block of size count at offset, e.g. a tile
+    Selection& add_block(const hsize_t *offset, const hsize_t *count)
+    {
+      space.select_hyperslab(H5S_SELECT_OR, offset, NULL, count, NULL);
+      return *this;
+    }
+
+    // appends n points. coords holds rank coordinates per point
+    Selection& add_points(size_t n, const hsize_t *coords)
+    {
+      if (n > 0)
+        space.select_elements(get_npoints() > 0 ? H5S_SELECT_APPEND : H5S_SELECT_SET, n, coords);
+      return *this;
+    }
+
+    Selection& add_points(const std::vector<hsize_t> &coords)
+    {
+      return coords.empty() ? *this : add_points(coords.size() / rank, &coords[0]);
+    }
+
+    hssize_t get_npoints() const { return space.get_select_npoints(); }
+
+    int get_rank() const { return rank; }
+
+    const Dataspace& get_file_space() const { return space; }
+
+    // one dimensional, with one element per selected point
+    Dataspace get_mem_space() const
+    {
+      hsize_t n = get_npoints();
+      hsize_t maxdims = n > 0 ? n : 1; // H5Screate_simple does not like zero sized maximal dimensions
+      return Dataspace::simple(1, &n, &maxdims);
+    }
+
+    template<class T>
+    void read(const Dataset &ds, T *data) const
+    {
+      if (get_npoints() > 0)
+        ds.read(get_mem_space(), space, data);
+    }
+
+    // unlike the above, collective MPI-IO transfers take place also without points, because they need all processes
+    template<class T>
+    void read(const Dataset &ds, T *data, const Properties &xfer) const
+    {
+      if (get_npoints() > 0 || is_collective(xfer))
+        ds.read(get_mem_space(), space, data, xfer);
+    }
+
+    template<class T, class A>
+    void read(const Dataset &ds, std::vector<T, A> &ret) const
+    {
+      ret.resize(get_npoints());
+      if (!ret.empty())
+        read(ds, &ret[0]);
+    }
+
+    template<class T>
+    void write(Dataset &ds, const T *data) const
+    {
+      if (get_npoints() > 0)
+        ds.write(get_mem_space(), space, data);
+    }
+
+    template<class T>
+    void write(Dataset &ds, const T *data, const Properties &xfer) const
+    {
+      if (get_npoints() > 0 || is_collective(xfer))
+        ds.write(get_mem_space(), space, data, xfer);
+    }
+
+    template<class T, class A>
+    void write(Dataset &ds, const std::vector<T, A> &data) const
+    {
+      if (data.size() != size_t(get_npoints()))
+        throw Exception("number of values differs from the number of selected points");
+      write(ds, &data[0]);
+    }
+};
+
+
+/*--------------------------------------------------
+ *            parallel chunk I/O
+ * ------------------------------------------------ */
+
+// performance figures of the parallel chunk I/O functions
+struct ChunkIOStats
+{
+  hsize_t chunks;                   // number of chunks transferred directly
+  unsigned long long stored_bytes;  // bytes of these chunks as stored in the file, i.e. after compression
+  unsigned long long chunk_bytes;   // bytes of these chunks before compression
+  unsigned long long bytes;         // bytes of the whole selection in memory
+  double seconds;                   // wall clock time of the whole operation
+  int threads;                      // number of worker threads, 0 if the serial fallback was used
+
+  double filter_seconds;             // time spent in (de)compression, summed over the worker threads
+
+  ChunkIOStats() : chunks(0), stored_bytes(0), chunk_bytes(0), bytes(0), seconds(0.), threads(0), filter_seconds(0.) {}
+  // uncompressed bytes per second
+  double throughput() const { return seconds > 0. ? bytes / seconds : 0.; }
+  // uncompressed bytes per second which one thread (de)compressed
+  double filter_throughput() const { return filter_seconds > 0. ? chunk_bytes / filter_seconds : 0.; }
+  double compression_ratio() const { return stored_bytes > 0 ? double(chunk_bytes) / stored_bytes : 0.; }
+};
+
+namespace internal
+{
+
+// checksum of the fletcher32 filter, the same algorithm as in the HDF5 library
+inline uint32_t fletcher32(const unsigned char *data, size_t nbytes)
+{
+  size_t len = nbytes / 2;
+  uint32_t sum1 = 0, sum2 = 0;
+  while (len)
+  {
+    size_t tlen = len > 360 ? 360 : len;
+    len -= tlen;
+    do
+    {
+      sum1 += (uint32_t)((((uint16_t)data[0]) << 8) | ((uint16_t)data[1]));
+      data += 2;
+      sum2 += sum1;
+    } while (--tlen);
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+  if (nbytes % 2)
+  {
+    sum1 += (uint32_t)(((uint16_t)*data) << 8);
+    sum2 += sum1;
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+  sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+  sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  return (sum2 << 16) | sum1;
+}
+
+// the shuffle filter stores byte b of all elements consecutively
+inline void shuffle(const char *src, char *dst, size_t nbytes, size_t type_size)
+{
+  size_t n = nbytes / type_size;
+  for (size_t b = 0; b < type_size; ++b)
+    for (size_t e = 0; e < n; ++e)
+      dst[b*n + e] = src[e*type_size + b];
+  std::memcpy(dst + n*type_size, src + n*type_size, nbytes - n*type_size); // leftover bytes are not shuffled
+}
+
+inline void unshuffle(const char *src, char *dst, size_t nbytes, size_t type_size)
+{
+  size_t n = nbytes / type_size;
+  for (size_t b = 0; b < type_size; ++b)
+    for (size_t e = 0; e < n; ++e)
+      dst[e*type_size + b] = src[b*n + e];
+  std::memcpy(dst + n*type_size, src + n*type_size, nbytes - n*type_size);
+}
+
+/*
+  Filter pipeline of a chunked dataset, reimplemented so that it can be applied outside of
+  the library, on worker threads. Supported are shuffle, fletcher32 and, with HDF_WRAPPER_HAS_ZLIB,
+  deflate. Datasets with other filters must go through the library.
+*/
+class FilterPipeline
+{
+    std::vector<H5Z_filter_t> filters;
+    std::vector<unsigned int> flags;
+    std::vector<int> levels; // deflate compression level
+    size_t type_size;
+    bool supported;
+
+  public:
+    FilterPipeline(const Properties &dcpl, size_t type_size_) : type_size(type_size_), supported(true)
+    {
+      int n = dcpl.get_nfilters();
+      for (int i = 0; i < n; ++i)
+      {
+        unsigned int cd_values[8], filter_flags;
+        size_t cd_nelmts = 8;
+        H5Z_filter_t f = dcpl.get_filter(i, &filter_flags, &cd_nelmts, cd_values);
+        if (f == H5Z_FILTER_SHUFFLE || f == H5Z_FILTER_FLETCHER32) {}
+#ifdef HDF_WRAPPER_HAS_ZLIB
+        else if (f == H5Z_FILTER_DEFLATE) {}
+#endif
+        else supported = false;
+        filters.push_back(f);
+        flags.push_back(filter_flags);
+        levels.push_back(cd_nelmts > 0 ? (int)cd_values[0] : 6);
+      }
+    }
+
+    bool is_supported() const { return supported; }
+
+    /*
+      Applies the filters to a chunk in place, like the library does when writing. Optional filters
+      which fail, i.e. deflate when the data does not shrink, are skipped and marked in filter_mask.
+      Returns false and sets error on failure. This function does not call into the HDF5 library.
+    */
+    bool encode(std::vector<char> &buf, std::vector<char> &tmp, uint32_t &filter_mask, std::string &error) const
+    {
+      filter_mask = 0;
+      for (size_t i = 0; i < filters.size(); ++i)
+      {
+        switch (filters[i])
+        {
+          case H5Z_FILTER_FLETCHER32:
+          {
+            uint32_t sum = fletcher32(reinterpret_cast<const unsigned char*>(buf.empty() ? NULL : &buf[0]), buf.size());
+            for (int b = 0; b < 4; ++b)
+              buf.push_back((char)((sum >> (8*b)) & 0xff));
+            break;
+          }
+          case H5Z_FILTER_SHUFFLE:
+            tmp.resize(buf.size());
+            if (!buf.empty())
+              shuffle(&buf[0], &tmp[0], buf.size(), type_size);
+            buf.swap(tmp);
+            break;
+#ifdef HDF_WRAPPER_HAS_ZLIB
+          case H5Z_FILTER_DEFLATE:
+          {
+            uLongf len = compressBound((uLong)buf.size());
+            tmp.resize(len);
+            int err = compress2(reinterpret_cast<Bytef*>(&tmp[0]), &len, reinterpret_cast<const Bytef*>(&buf[0]), (uLong)buf.size(), levels[i]);
+            if (err != Z_OK)
+            {
+              error = "error deflating chunk";
+              return false;
+            }
+            if (len >= buf.size() && (flags[i] & H5Z_FLAG_OPTIONAL))
+            {
+              filter_mask |= 1u << i;
+              break;
+            }
+            tmp.resize(len);
+            buf.swap(tmp);
+            break;
+          }
+#endif
+          default:
+            error = "unsupported filter";
+            return false;
+        }
+      }
+      return true;
+    }
+
+    /*
+      Reverses the filters which are not excluded by filter_mask, in place. buf holds the chunk
+      as stored in the file, tmp is scratch space. Returns false and sets error on failure.
+      This function does not call into the HDF5 library.
+    */
+    bool decode(std::vector<char> &buf, std::vector<char> &tmp, unsigned int filter_mask, size_t chunk_nbytes, std::string &error) const
+    {
+      for (int i = (int)filters.size() - 1; i >= 0; --i)
+      {
+        if (filter_mask & (1u << i))
+          continue;
+        switch (filters[i])
+        {
+          case H5Z_FILTER_FLETCHER32:
+          {
+            if (buf.size() < 4)
+            {
+              error = "chunk too small for fletcher32 checksum";
+              return false;
+            }
+            size_t n = buf.size() - 4;
+            const unsigned char *p = reinterpret_cast<const unsigned char*>(&buf[0]);
+            uint32_t stored = (uint32_t)p[n] | ((uint32_t)p[n+1] << 8) | ((uint32_t)p[n+2] << 16) | ((uint32_t)p[n+3] << 24);
+            uint32_t sum = fletcher32(p, n);
+            uint32_t reversed = ((sum & 0xff) << 24) | ((sum & 0xff00) << 8) | ((sum >> 8) & 0xff00) | (sum >> 24); // written by old library versions
+            if (stored != sum && stored != reversed)
+            {
+              error = "fletcher32 checksum mismatch";
+              return false;
+            }
+            buf.resize(n);
+            break;
+          }
+          case H5Z_FILTER_SHUFFLE:
+            tmp.resize(buf.size());
+            if (!buf.empty())
+              unshuffle(&buf[0], &tmp[0], buf.size(), type_size);
+            buf.swap(tmp);
+            break;
+#ifdef HDF_WRAPPER_HAS_ZLIB
+          case H5Z_FILTER_DEFLATE:
+          {
+            tmp.resize(chunk_nbytes + 4 * filters.size()); // checksums could be compressed, too
+            uLongf len = (uLongf)tmp.size();
+            int err = uncompress(reinterpret_cast<Bytef*>(&tmp[0]), &len, reinterpret_cast<const Bytef*>(&buf[0]), (uLong)buf.size());
+            if (err != Z_OK)
+            {
+              error = "error inflating chunk";
+              return false;
+            }
+            tmp.resize(len);
+            buf.swap(tmp);
+            break;
+          }
+#endif
+          default:
+            error = "unsupported filter";
+            return false;
+        }
+      }
+      if (buf.size() != chunk_nbytes)
+      {
+        error = "unexpected size of decoded chunk";
+        return false;
+      }
+      return true;
+    }
+};
+
+
+// the regular grid of chunks covering a dataset
+class ChunkGrid
+{
+    void copy(char *chunk, const hsize_t *offset, char *array, bool to_array) const
+    {
+      hsize_t valid[H5S_MAX_RANK], idx[H5S_MAX_RANK] = {};
+      for (int i = 0; i < rank; ++i)
+        valid[i] = std::min(chunk_dims[i], dims[i] - offset[i]);
+      size_t run = valid[rank-1] * type_size;
+      while (true)
+      {
+        hsize_t cpos = 0, apos = 0;
+        for (int i = 0; i < rank; ++i)
+        {
+          cpos = cpos * chunk_dims[i] + idx[i];
+          apos = apos * dims[i] + offset[i] + idx[i];
+        }
+        if (to_array)
+          std::memcpy(array + apos * type_size, chunk + cpos * type_size, run);
+        else
+          std::memcpy(chunk + cpos * type_size, array + apos * type_size, run);
+        int i = rank - 2;
+        for (; i >= 0; --i)
+        {
+          if (++idx[i] < valid[i]) break;
+          idx[i] = 0;
+        }
+        if (i < 0) break;
+      }
+    }
+
+  public:
+    int rank;
+    hsize_t dims[H5S_MAX_RANK], chunk_dims[H5S_MAX_RANK], nchunks[H5S_MAX_RANK];
+    hsize_t count;       // total number of chunks
+    size_t type_size;
+    size_t chunk_nbytes; // size of an unfiltered chunk
+
+    ChunkGrid(int rank_, const hsize_t *dims_, const hsize_t *chunk_dims_, size_t type_size_) :
+      rank(rank_), count(1), type_size(type_size_), chunk_nbytes(type_size_)
+    {
+      for (int i = 0; i < rank; ++i)
+      {
+        dims[i] = dims_[i];
+        chunk_dims[i] = chunk_dims_[i];
+        nchunks[i] = (dims[i] + chunk_dims[i] - 1) / chunk_dims[i];
+        count *= nchunks[i];
+        chunk_nbytes *= chunk_dims[i];
+      }
+    }
+
+    // offset in elements of the chunk with linear index idx
+    void get_offset(hsize_t idx, hsize_t *offset) const
+    {
+      for (int i = rank - 1; i >= 0; --i)
+      {
+        offset[i] = (idx % nchunks[i]) * chunk_dims[i];
+        idx /= nchunks[i];
+      }
+    }
+
+    // copies the part of the chunk at offset which lies within the dataset into an array of the dataset dimensions
+    void scatter(const char *chunk, const hsize_t *offset, char *array) const
+    {
+      copy(const_cast<char*>(chunk), offset, array, true);
+    }
+
+    // inverse of scatter. Parts of edge chunks outside of the dataset are zeroed.
+    void gather(const char *array, const hsize_t *offset, char *chunk) const
+    {
+      for (int i = 0; i < rank; ++i)
+      {
+        if (offset[i] + chunk_dims[i] > dims[i])
+        {
+          std::memset(chunk, 0, chunk_nbytes);
+          break;
+        }
+      }
+      copy(chunk, offset, const_cast<char*>(array), false);
+    }
+};
+
+
+struct RawChunk
+{
+  hsize_t offset[H5S_MAX_RANK];
+  uint32_t filter_mask;
+  std::vector<char> data;
+};
+
+
+// queue between the thread which talks to the library and the worker threads
+template<class Item>
+class BoundedQueue
+{
+    std::deque<Item> items;
+    size_t capacity;
+    bool closed;
+    std::mutex m;
+    std::condition_variable cv_not_full, cv_not_empty;
+
+  public:
+    explicit BoundedQueue(size_t capacity_) : capacity(capacity_), closed(false) {}
+
+    void push(Item &item)
+    {
+      std::unique_lock<std::mutex> lock(m);
+      while (items.size() >= capacity && !closed)
+        cv_not_full.wait(lock);
+      items.push_back(std::move(item));
+      cv_not_empty.notify_one();
+    }
+
+    // blocks until an item is available. Returns false if the queue is closed and empty.
+    bool pop(Item &item)
+    {
+      std::unique_lock<std::mutex> lock(m);
+      while (items.empty() && !closed)
+        cv_not_empty.wait(lock);
+      if (items.empty())
+        return false;
+      item = std::move(items.front());
+      items.pop_front();
+      cv_not_full.notify_one();
+      return true;
+    }
+
+    void close()
+    {
+      std::lock_guard<std::mutex> lock(m);
+      closed = true;
+      cv_not_empty.notify_all();
+      cv_not_full.notify_all();
+    }
+};
+
+
+/*
+  Completed chunks, handed out in the order of their linear index. Producers wait
+  while they are more than window chunks ahead of the consumer, which bounds memory usage.
+*/
+class OrderedChunks
+{
+    std::map<hsize_t, RawChunk> done;
+    hsize_t next;
+    hsize_t window;
+    bool closed;
+    std::mutex m;
+    std::condition_variable cv_taken, cv_put;
+
+  public:
+    explicit OrderedChunks(hsize_t window_) : next(0), window(window_), closed(false) {}
+
+    // blocks until chunk idx may be produced. Returns false if closed.
+    bool wait_for_slot(hsize_t idx)
+    {
+      std::unique_lock<std::mutex> lock(m);
+      while (idx >= next + window && !closed)
+        cv_taken.wait(lock);
+      return !closed;
+    }
+
+    void put(hsize_t idx, RawChunk &chunk)
+    {
+      std::lock_guard<std::mutex> lock(m);
+      done[idx] = std::move(chunk);
+      cv_put.notify_all();
+    }
+
+    // blocks until chunk idx is available. Chunks must be taken in order. Returns false if closed.
+    bool take(hsize_t idx, RawChunk &chunk)
+    {
+      std::unique_lock<std::mutex> lock(m);
+      std::map<hsize_t, RawChunk>::iterator it;
+      while ((it = done.find(idx)) == done.end() && !closed)
+        cv_put.wait(lock);
+      if (it == done.end())
+        return false;
+      chunk = std::move(it->second);
+      done.erase(it);
+      next = idx + 1;
+      cv_taken.notify_all();
+      return true;
+    }
+
+    void close()
+    {
+      std::lock_guard<std::mutex> lock(m);
+      closed = true;
+      cv_taken.notify_all();
+      cv_put.notify_all();
+    }
+};
+
+
+/*
+  Worker threads exchanging data with the calling thread through a queue. The destructor closes the queue and joins the threads,
+  so that they are also shut down when the calling thread leaves with an exception.
+  Workers must not throw. They report failure through fail(), which also closes the queue. The calling thread
+  should check failed() and join(), which turns the failure into an Exception.
+*/
+template<class Queue>
+class WorkerThreads
+{
+    std::vector<std::thread> threads;
+    Queue &queue;
+    std::mutex m;
+    std::string first_error;
+    std::atomic<bool> has_failed;
+
+  public:
+    WorkerThreads(Queue &queue_) : queue(queue_), has_failed(false) {}
+
+    template<class F>
+    void start(int n, F f)
+    {
+      for (int i = 0; i < n; ++i)
+        threads.push_back(std::thread(f));
+    }
+
+    void fail(const std::string &msg)
+    {
+      std::lock_guard<std::mutex> lock(m);
+      if (!has_failed)
+        first_error = msg;
+      has_failed = true;
+      queue.close();
+    }
+
+    bool failed() const { return has_failed; }
+
+    void join()
+    {
+      queue.close();
+      for (size_t i = 0; i < threads.size(); ++i)
+        if (threads[i].joinable()) threads[i].join();
+      if (has_failed)
+        throw Exception(first_error);
+    }
+
+    ~WorkerThreads()
+    {
+      queue.close();
+      for (size_t i = 0; i < threads.size(); ++i)
+        if (threads[i].joinable()) threads[i].join();
+    }
+};
+
+
+inline int default_num_threads(int nthreads)
+{
+  if (nthreads > 0) return nthreads;
+  unsigned int n = std::thread::hardware_concurrency();
+  return n > 0 ? (int)n : 1;
+}
+
+
+inline double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace internal
+
+
+#if H5_VERSION_GE(1,10,5)
+namespace internal
+{
+
+// xfer may be NULL for the default transfer properties
+template<class T>
+inline ChunkIOStats read_chunks_parallel(const Dataset &ds, T *data, int nthreads, const Properties *xfer)
+{
+  hid_t dxpl = xfer && xfer->get_id() >= 0 ? xfer->get_id() : H5P_DEFAULT;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  ChunkIOStats stats;
+  hsize_t dims[H5S_MAX_RANK], cdims[H5S_MAX_RANK];
+  std::unique_ptr<internal::ChunkGrid> grid;
+  std::unique_ptr<internal::FilterPipeline> pipeline;
+  {
+    internal::LibraryLockGuard lock(internal::library_mutex());
+    Dataspace sp = ds.get_dataspace();
+    int rank = sp.get_dims(dims);
+    Properties dcpl = ds.get_creation_properties();
+    const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+    size_t type_size = memtype.get_size();
+    stats.bytes = (unsigned long long)sp.get_npoints() * type_size;
+    if (rank > 0 && dcpl.get_chunk(cdims) == rank && !memtype.is_variable_length() && ds.get_datatype().is_equal(memtype))
+      pipeline.reset(new internal::FilterPipeline(dcpl, type_size));
+    if (!pipeline || !pipeline->is_supported())
+    {
+      if (xfer) ds.read(data, *xfer); else ds.read(data);
+      stats.seconds = internal::seconds_since(t0);
+      return stats;
+    }
+    grid.reset(new internal::ChunkGrid(rank, dims, cdims, type_size));
+  }
+
+  char *array = reinterpret_cast<char*>(data);
+  stats.threads = internal::default_num_threads(nthreads);
+  internal::BoundedQueue<internal::RawChunk> queue(2 * stats.threads);
+  internal::WorkerThreads<internal::BoundedQueue<internal::RawChunk> > workers(queue);
+  const internal::ChunkGrid &g = *grid;
+  const internal::FilterPipeline &p = *pipeline;
+  std::mutex stats_mutex;
+  workers.start(stats.threads, [&]()
+  {
+    internal::RawChunk chunk;
+    std::vector<char> tmp;
+    std::string error;
+    double filter_seconds = 0.;
+    while (queue.pop(chunk))
+    {
+      if (workers.failed()) continue; // drain the queue
+      std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+      if (!p.decode(chunk.data, tmp, chunk.filter_mask, g.chunk_nbytes, error))
+        workers.fail(error);
+      else
+        g.scatter(&chunk.data[0], chunk.offset, array);
+      filter_seconds += internal::seconds_since(t);
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    stats.filter_seconds += filter_seconds;
+  });
+
+  for (hsize_t c = 0; c < g.count && !workers.failed(); ++c)
+  {
+    internal::RawChunk chunk;
+    g.get_offset(c, chunk.offset);
+    {
+      internal::LibraryLockGuard lock(internal::library_mutex());
+      unsigned int filter_mask;
+      haddr_t addr;
+      hsize_t size;
+      if (H5Dget_chunk_info_by_coord(ds.get_id(), chunk.offset, &filter_mask, &addr, &size) < 0)
+        throw Exception("unable to get chunk info");
+      if (addr == HADDR_UNDEF)
+      { // not allocated, let the library produce the fill value
+        hsize_t count[H5S_MAX_RANK];
+        for (int i = 0; i < g.rank; ++i)
+          count[i] = std::min(g.chunk_dims[i], g.dims[i] - chunk.offset[i]);
+        Dataspace filesp = ds.get_dataspace();
+        filesp.select_hyperslab(chunk.offset, NULL, count, NULL);
+        Dataspace memsp = Dataspace::simple(g.rank, g.dims);
+        memsp.select_hyperslab(chunk.offset, NULL, count, NULL);
+        if (xfer) ds.read(memsp, filesp, data, *xfer); else ds.read(memsp, filesp, data);
+        continue;
+      }
+      chunk.data.resize(size);
+      if (H5Dread_chunk(ds.get_id(), dxpl, chunk.offset, &chunk.filter_mask, &chunk.data[0]) < 0)
+        throw Exception("unable to read raw chunk");
+    }
+    ++stats.chunks;
+    stats.stored_bytes += chunk.data.size();
+    stats.chunk_bytes += g.chunk_nbytes;
+    queue.push(chunk);
+  }
+  workers.join();
+  stats.seconds = internal::seconds_since(t0);
+  return stats;
+}
+
+} // namespace internal
+
+/*
+  Reads the whole dataset, bypassing the filter pipeline of the library. The calling thread fetches
+  the raw chunks with H5Dread_chunk while holding the library lock. nthreads worker threads (default:
+  number of cores) decode the chunks and copy them into place. Chunks which were never written are read
+  through the library, so that they get the fill value.
+  Falls back to Dataset::read if the dataset is not chunked, has filters which cannot be decoded here
+  (see internal::FilterPipeline), or if the memory type is not the same as the type on disk.
+*/
+template<class T>
+inline ChunkIOStats read_dataset_parallel(const Dataset &ds, T *data, int nthreads = 0)
+{
+  return internal::read_chunks_parallel(ds, data, nthreads, NULL);
+}
+
+// raw chunks and library reads, e.g. of unallocated chunks, use the transfer property list xfer.
+// A data transform only applies to the latter, unless the read falls back to Dataset::read.
+template<class T>
+inline ChunkIOStats read_dataset_parallel(const Dataset &ds, T *data, const Properties &xfer, int nthreads = 0)
+{
+  return internal::read_chunks_parallel(ds, data, nthreads, &xfer);
+}
+
+template<class T, class A>
+inline ChunkIOStats read_dataset_parallel(const Dataset &ds, std::vector<T, A> &ret, int nthreads = 0)
+{
+  ret.resize(ds.get_dataspace().get_npoints());
+  return read_dataset_parallel(ds, &ret[0], nthreads);
+}
+
+template<class T, class A>
+inline ChunkIOStats read_dataset_parallel(const Dataset &ds, std::vector<T, A> &ret, const Properties &xfer, int nthreads = 0)
+{
+  ret.resize(ds.get_dataspace().get_npoints());
+  return read_dataset_parallel(ds, &ret[0], xfer, nthreads);
+}
+
+
+namespace internal
+{
+
+// xfer may be NULL for the default transfer properties
+template<class T>
+inline ChunkIOStats write_chunks_parallel(Dataset &ds, const T *data, int nthreads, const Properties *xfer)
+{
+  hid_t dxpl = xfer && xfer->get_id() >= 0 ? xfer->get_id() : H5P_DEFAULT;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  ChunkIOStats stats;
+  hsize_t dims[H5S_MAX_RANK], cdims[H5S_MAX_RANK];
+  std::unique_ptr<internal::ChunkGrid> grid;
+  std::unique_ptr<internal::FilterPipeline> pipeline;
+  {
+    internal::LibraryLockGuard lock(internal::library_mutex());
+    Dataspace sp = ds.get_dataspace();
+    int rank = sp.get_dims(dims);
+    Properties dcpl = ds.get_creation_properties();
+    const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+    size_t type_size = memtype.get_size();
+    stats.bytes = (unsigned long long)sp.get_npoints() * type_size;
+    if (rank > 0 && dcpl.get_chunk(cdims) == rank && !memtype.is_variable_length() && ds.get_datatype().is_equal(memtype))
+      pipeline.reset(new internal::FilterPipeline(dcpl, type_size));
+    if (!pipeline || !pipeline->is_supported())
+    {
+      if (xfer) ds.write(data, *xfer); else ds.write(data);
+      stats.seconds = internal::seconds_since(t0);
+      return stats;
+    }
+    grid.reset(new internal::ChunkGrid(rank, dims, cdims, type_size));
+  }
+
+  const char *array = reinterpret_cast<const char*>(data);
+  stats.threads = internal::default_num_threads(nthreads);
+  internal::OrderedChunks results(2 * stats.threads);
+  internal::WorkerThreads<internal::OrderedChunks> workers(results);
+  const internal::ChunkGrid &g = *grid;
+  const internal::FilterPipeline &p = *pipeline;
+  std::atomic<hsize_t> next_chunk(0);
+  std::mutex stats_mutex;
+  workers.start(stats.threads, [&]()
+  {
+    std::vector<char> tmp;
+    std::string error;
+    double filter_seconds = 0.;
+    for (hsize_t c = next_chunk++; c < g.count; c = next_chunk++)
+    {
+      if (!results.wait_for_slot(c))
+        break;
+      internal::RawChunk chunk;
+      g.get_offset(c, chunk.offset);
+      chunk.data.resize(g.chunk_nbytes);
+      g.gather(array, chunk.offset, &chunk.data[0]);
+      std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+      if (!p.encode(chunk.data, tmp, chunk.filter_mask, error))
+      {
+        workers.fail(error);
+        break;
+      }
+      filter_seconds += internal::seconds_since(t);
+      results.put(c, chunk);
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    stats.filter_seconds += filter_seconds;
+  });
+
+  for (hsize_t c = 0; c < g.count; ++c)
+  {
+    internal::RawChunk chunk;
+    if (!results.take(c, chunk))
+      break; // a worker failed
+    {
+      internal::LibraryLockGuard lock(internal::library_mutex());
+      if (H5Dwrite_chunk(ds.get_id(), dxpl, chunk.filter_mask, chunk.offset, chunk.data.size(), &chunk.data[0]) < 0)
+        throw Exception("unable to write raw chunk");
+    }
+    ++stats.chunks;
+    stats.stored_bytes += chunk.data.size();
+    stats.chunk_bytes += g.chunk_nbytes;
+  }
+  workers.join();
+  stats.seconds = internal::seconds_since(t0);
+  return stats;
+}
+
+} // namespace internal
+
+/*
+  Writes the whole dataset, bypassing the filter pipeline of the library. nthreads worker threads
+  (default: number of cores) cut the data into chunks and run the filters of the dataset on them
+  concurrently. The calling thread commits the chunks in order with H5Dwrite_chunk while holding the
+  library lock. The result is the same as a regular write, so any HDF5 reader can read it.
+  Falls back to Dataset::write under the same conditions as read_dataset_parallel. Without
+  HDF_WRAPPER_HAS_ZLIB this includes deflate compressed datasets.
+*/
+template<class T>
+inline ChunkIOStats write_dataset_parallel(Dataset &ds, const T *data, int nthreads = 0)
+{
+  return internal::write_chunks_parallel(ds, data, nthreads, NULL);
+}
+
+// the raw chunks and the fallback write use the transfer property list xfer
+template<class T>
+inline ChunkIOStats write_dataset_parallel(Dataset &ds, const T *data, const Properties &xfer, int nthreads = 0)
+{
+  return internal::write_chunks_parallel(ds, data, nthreads, &xfer);
+}
+
+template<class T, class A>
+inline ChunkIOStats write_dataset_parallel(Dataset &ds, const std::vector<T, A> &data, int nthreads = 0)
+{
+  return write_dataset_parallel(ds, &data[0], nthreads);
+}
+
+template<class T, class A>
+inline ChunkIOStats write_dataset_parallel(Dataset &ds, const std::vector<T, A> &data, const Properties &xfer, int nthreads = 0)
+{
+  return write_dataset_parallel(ds, &data[0], xfer, nthreads);
+}
+#endif
+
+
+/*--------------------------------------------------
+ *            appending to extensible datasets
+ * ------------------------------------------------ */
+
+/*
+  Appends records along the first dimension of an extensible dataset (see Dataspace::simple_unlimited).
+  A record comprises all elements with the same index in the first dimension, i.e. the product of
+  the remaining dimensions. Records are gathered in memory and written in batches, growing the
+  extent of the dataset once per batch. By default, the batch size is the chunk size along the first
+  dimension, so that each flush writes whole chunks.
+  Buffered records are flushed by the destructor, but errors can only be observed when flush() is called explicitly.
+*/
+template<class T>
+class AppendWriter
+{
+    Dataset ds;
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];  // dims[0] = number of records on disk
+    hsize_t record_size;         // number of elements in one record
+    hsize_t batch_size;          // number of records buffered before a flush
+    std::vector<T> buffer;
+    Properties xfer;
+
+  public:
+    AppendWriter(const Dataset &ds_, hsize_t batch_size_ = 0) : AppendWriter(ds_, batch_size_, Properties()) {}
+
+    // flushes write with the transfer property list xfer
+    AppendWriter(const Dataset &ds_, hsize_t batch_size_, const Properties &xfer_) : ds(ds_), batch_size(batch_size_), xfer(xfer_)
+    {
+      hsize_t maxdims[H5S_MAX_RANK];
+      rank = ds.get_dataspace().get_dims(dims, maxdims);
+      if (rank < 1 || maxdims[0] != H5S_UNLIMITED)
+        throw Exception("AppendWriter requires a dataset with unlimited first dimension");
+      record_size = 1;
+      for (int i = 1; i < rank; ++i)
+        record_size *= dims[i];
+      if (batch_size == 0)
+      {
+        hsize_t cdims[H5S_MAX_RANK];
+        batch_size = ds.get_creation_properties().get_chunk(cdims) > 0 ? cdims[0] : 1;
+      }
+      buffer.reserve(batch_size * record_size);
+    }
+
+    ~AppendWriter()
+    {
+      try
+      {
+        flush();
+      }
+      catch (const Exception &)
+      {
+        // cannot throw from a destructor. call flush() explicitly to handle errors.
+      }
+    }
+
+    // appends one record, consisting of record_size() elements
+    void append(const T *record)
+    {
+      buffer.insert(buffer.end(), record, record + record_size);
+      if (buffer.size() >= batch_size * record_size)
+        flush();
+    }
+
+    // for one dimensional datasets, where records are single elements
+    void append(const T &value)
+    {
+      assert(record_size == 1);
+      append(&value);
+    }
+
+    // appends n consecutive records
+    void append(const T *records, hsize_t n)
+    {
+      for (hsize_t i = 0; i < n; ++i)
+        append(records + i * record_size);
+    }
+
+    // writes the buffered records to the dataset
+    void flush()
+    {
+      if (buffer.empty())
+        return;
+      hsize_t offset[H5S_MAX_RANK] = {};
+      hsize_t count[H5S_MAX_RANK], new_dims[H5S_MAX_RANK];
+      offset[0] = dims[0];
+      count[0] = buffer.size() / record_size;
+      new_dims[0] = dims[0] + count[0];
+      for (int i = 1; i < rank; ++i)
+        new_dims[i] = count[i] = dims[i];
+      ds.set_extent(new_dims);
+      Dataspace filespace = ds.get_dataspace();
+      filespace.select_hyperslab(offset, NULL, count, NULL);
+      Dataspace memspace = Dataspace::simple(rank, count);
+      ds.write(memspace, filespace, &buffer[0], xfer);
+      // only now, so that a failed flush keeps the buffer and can be repeated at the same offset
+      dims[0] = new_dims[0];
+      buffer.clear();
+    }
+
+    // number of records including buffered ones
+    hsize_t size() const { return dims[0] + buffer.size() / record_size; }
+
+    hsize_t get_record_size() const { return record_size; }
+
+    Dataset get_dataset() const { return ds; }
+};
+
+
+/*--------------------------------------------------
+ *            prefetching block reads
+ * ------------------------------------------------ */
+
+/*
+  Reads a dataset in consecutive blocks of rows along the first dimension. While the caller
+  processes the current block, a background thread reads the next one into a second buffer.
+  By default, a block is one chunk along the first dimension, or about 1 MB for contiguous datasets.
+  Usage:
+    BlockReader<float> reader(ds);
+    while (reader.next())
+      process(reader.data(), reader.rows());
+  The data of a block stays valid until the next call to next(). The background thread holds the
+  LibraryLock while it reads, see is_library_threadsafe.
+*/
+template<class T>
+class BlockReader
+{
+    Dataset ds;
+    Properties xfer;
+    int rank;
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t row_size;     // number of elements in one row
+    hsize_t block_rows;
+    hsize_t nblocks;
+    std::unique_ptr<T[]> buffers[2]; // block j goes into buffers[j % 2]. not std::vector, because of std::vector<bool>
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    long long current;    // block held by the caller, -1 before the first call to next()
+    hsize_t nread;        // number of blocks read by the background thread
+    bool stop;
+    std::exception_ptr error;
+    double wait_seconds;
+    std::thread thread;
+
+    void read_block(hsize_t j)
+    {
+      hsize_t offset[H5S_MAX_RANK] = {};
+      hsize_t count[H5S_MAX_RANK];
+      offset[0] = j * block_rows;
+      count[0] = std::min(block_rows, dims[0] - offset[0]);
+      for (int i = 1; i < rank; ++i)
+        count[i] = dims[i];
+      internal::LibraryLockGuard lock(internal::library_mutex());
+      Dataspace filespace = ds.get_dataspace();
+      filespace.select_hyperslab(offset, NULL, count, NULL);
+      ds.read(Dataspace::simple(rank, count), filespace, buffers[j % 2].get(), xfer);
+    }
+
+    void run()
+    {
+      for (hsize_t j = 0; j < nblocks; ++j)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cond.wait(lock, [this, j]() { return stop || (long long)j <= current + 1; }); // the buffer of block j-2 must be released
+          if (stop) return;
+        }
+        try
+        {
+          read_block(j);
+        }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          error = std::current_exception();
+          cond.notify_all();
+          return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        nread = j + 1;
+        cond.notify_all();
+      }
+    }
+
+    BlockReader(const BlockReader &);
+    BlockReader& operator=(const BlockReader &);
+
+  public:
+    BlockReader(const Dataset &ds_, hsize_t block_rows_ = 0) : BlockReader(ds_, block_rows_, Properties()) {}
+
+    // blocks are read with the transfer property list xfer
+    BlockReader(const Dataset &ds_, hsize_t block_rows_, const Properties &xfer_) :
+      ds(ds_), xfer(xfer_), block_rows(block_rows_), current(-1), nread(0), stop(false), wait_seconds(0.)
+    {
+      rank = ds.get_dataspace().get_dims(dims);
+      if (rank < 1)
+        throw Exception("BlockReader requires a dataset of rank one or higher");
+      row_size = 1;
+      for (int i = 1; i < rank; ++i)
+        row_size *= dims[i];
+      if (block_rows == 0)
+      {
+        hsize_t cdims[H5S_MAX_RANK];
+        if (ds.get_creation_properties().get_chunk(cdims) > 0)
+          block_rows = cdims[0];
+        else
+          block_rows = std::max<hsize_t>(1, (1<<20) / std::max<hsize_t>(1, row_size * sizeof(T)));
+      }
+      nblocks = (dims[0] + block_rows - 1) / block_rows;
+      hsize_t n = std::min(block_rows, dims[0]) * row_size;
+      buffers[0].reset(new T[n]);
+      if (nblocks > 1)
+        buffers[1].reset(new T[n]);
+      internal::TypeRegistry<T>::memtype(); // create the type on this thread
+      thread = std::thread(&BlockReader::run, this);
+    }
+
+    ~BlockReader()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      cond.notify_all();
+      thread.join();
+    }
+
+    // advances to the next block. returns false after the last block.
+    bool next()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (current + 1 >= (long long)nblocks)
+        return false;
+      ++current; // releases the buffer of the previous block
+      cond.notify_all();
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+      cond.wait(lock, [this]() { return (long long)nread > current || error; });
+      wait_seconds += internal::seconds_since(t0);
+      if (error)
+        std::rethrow_exception(error);
+      return true;
+    }
+
+    // the current block. before the first call to next() there is none, and data() is NULL and rows() zero
+    const T* data() const { return current < 0 ? NULL : buffers[current % 2].get(); }
+
+    // number of rows in the current block
+    hsize_t rows() const { return current < 0 ? 0 : std::min(block_rows, dims[0] - first_row()); }
+
+    // index of the first row of the current block in the dataset
+    hsize_t first_row() const { return current < 0 ? 0 : current * block_rows; }
+
+    hsize_t get_row_size() const { return row_size; }
+
+    hsize_t get_block_rows() const { return block_rows; }
+
+    hsize_t get_num_blocks() const { return nblocks; }
+
+    // total time next() waited for blocks to be read. small values mean the reads were hidden behind processing.
+    double get_wait_seconds() const { return wait_seconds; }
+};
+
+
+/*--------------------------------------------------
+ *            projections of compound datasets
+ * ------------------------------------------------ */
+
+namespace internal
+{
+
+// throws unless the compound type disktype has a member of this name that is convertible to memtype
+inline void check_compound_member(const Datatype &disktype, const std::string &name, const Datatype &memtype)
+{
+  int idx = disktype.get_member_index(name);
+  if (idx < 0)
+    throw NameLookupError(name);
+  if (!disktype.get_member_type(idx).is_convertible_to(memtype))
+    throw Exception("cannot convert compound member '"+name+"' to the requested type");
+}
+
+// throws unless all members of the compound memtype are in disktype
+inline void validate_projection(const Datatype &disktype, const Datatype &memtype)
+{
+  if (disktype.get_class() != H5T_COMPOUND)
+    throw Exception("projection of a dataset which is not of compound type");
+  for (int i = 0; i < memtype.get_nmembers(); ++i)
+    check_compound_member(disktype, memtype.get_member_name(i), memtype.get_member_type(i));
+}
+
+}
+
+/*
+  Reads selected members ("fields") of a compound dataset into separate arrays (struct of arrays).
+  The library only transfers the requested members. A single field is read directly into its array.
+  Several fields are read in one pass into a packed temporary buffer, which is then split up.
+
+    Projection(ds).field("x", xs).field("id", ids).read();
+*/
+class Projection
+{
+    struct Field
+    {
+      std::string name;
+      Datatype memtype;
+      size_t size;
+      char *dest;
+    };
+    Dataset ds;
+    Datatype disktype;
+    hssize_t npoints;
+    std::vector<Field> fields;
+
+    static Datatype make_compound(size_t size)
+    {
+      hid_t id = H5Tcreate(H5T_COMPOUND, size);
+      if (id < 0)
+        throw Exception("error creating compound type");
+      return Datatype(id, internal::NoIncRC());
+    }
+
+  public:
+    explicit Projection(const Dataset &ds_) : ds(ds_), disktype(ds_.get_datatype()), npoints(ds_.get_dataspace().get_npoints())
+    {
+      if (disktype.get_class() != H5T_COMPOUND)
+        throw Exception("projection of a dataset which is not of compound type");
+    }
+
+    // dest must hold size() elements
+    template<class T>
+    Projection& field(const std::string &name, T *dest)
+    {
+      static_assert(std::is_pod<T>::value, "fields are copied bytewise. Use FixedStrings or StringRef for strings");
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+      internal::check_compound_member(disktype, name, memtype);
+      Field f = { name, memtype, sizeof(T), reinterpret_cast<char*>(dest) };
+      fields.push_back(f);
+      return *this;
+    }
+
+    template<class T, class A>
+    Projection& field(const std::string &name, std::vector<T, A> &dest)
+    {
+      dest.resize(npoints);
+      return field(name, &dest[0]);
+    }
+
+    // number of records
+    hssize_t size() const { return npoints; }
+
+    void read() const
+    {
+      if (fields.empty())
+        return;
+      if (fields.size() == 1)
+      {
+        Datatype memtype = make_compound(fields[0].size);
+        if (H5Tinsert(memtype.get_id(), fields[0].name.c_str(), 0, fields[0].memtype.get_id()) < 0)
+          throw Exception("error inserting compound member "+fields[0].name);
+        ds.read(memtype, fields[0].dest);
+        return;
+      }
+      size_t record_size = 0;
+      for (size_t k = 0; k < fields.size(); ++k)
+        record_size += fields[k].size;
+      Datatype memtype = make_compound(record_size);
+      size_t offset = 0;
+      for (size_t k = 0; k < fields.size(); ++k)
+      {
+        if (H5Tinsert(memtype.get_id(), fields[k].name.c_str(), offset, fields[k].memtype.get_id()) < 0)
+          throw Exception("error inserting compound member "+fields[k].name);
+        offset += fields[k].size;
+      }
+      std::vector<char> buffer(record_size * npoints);
+      ds.read(memtype, &buffer[0]);
+      offset = 0;
+      for (size_t k = 0; k < fields.size(); ++k)
+      {
+        const char *src = &buffer[offset];
+        for (hssize_t i = 0; i < npoints; ++i)
+          std::memcpy(fields[k].dest + i * fields[k].size, src + i * record_size, fields[k].size);
+        offset += fields[k].size;
+      }
+    }
+};
+
+/*
+  Reads a compound dataset into a narrower struct T, registered with HDF5_WRAPPER_COMPOUND_BEGIN.
+  Members are matched by name. Members of the dataset which T does not have are not transferred.
+*/
+template<class T>
+inline void read_projected(const Dataset &ds, T *data)
+{
+  internal::validate_projection(ds.get_datatype(), internal::TypeRegistry<T>::memtype());
+  ds.read(data);
+}
+
+template<class T, class A>
+inline void read_projected(const Dataset &ds, std::vector<T, A> &ret)
+{
+  ret.resize(ds.get_dataspace().get_npoints());
+  read_projected(ds, &ret[0]);
+}
+
+
+/*--------------------------------------------------
+ *            catalogs of files
+ * ------------------------------------------------ */
+
+// metadata of an object, as collected by build_catalog
+struct CatalogEntry
+{
+  std::string path;            // relative to the group the catalog was built from, "." for the group itself
+  H5O_type_t type;
+  hsize_t num_attrs;
+  // for datasets
+  std::vector<hsize_t> dims;   // empty for scalar datasets
+  H5T_class_t type_class;      // also for named datatypes
+  size_t type_size;
+  H5D_layout_t layout;
+  std::vector<hsize_t> chunk_dims;
+  std::vector<H5Z_filter_t> filters;
+
+  CatalogEntry() : type(H5O_TYPE_UNKNOWN), num_attrs(0), type_class(H5T_NO_CLASS), type_size(0), layout(H5D_LAYOUT_ERROR) {}
+
+  bool is_group() const { return type == H5O_TYPE_GROUP; }
+  bool is_dataset() const { return type == H5O_TYPE_DATASET; }
+
+  hsize_t get_npoints() const
+  {
+    hsize_t n = 1;
+    for (size_t i = 0; i < dims.size(); ++i)
+      n *= dims[i];
+    return n;
+  }
+};
+
+
+/*
+  The objects below a group, with their metadata. A catalog can be written to a stream and
+  read back, so that it needs not be rebuilt as long as the file is unchanged, see matches.
+*/
+class Catalog
+{
+    std::vector<CatalogEntry> entries;
+    std::map<std::string, size_t> by_path;
+    hsize_t file_size, free_space; // a fingerprint of the file
+
+  public:
+    Catalog() : file_size(0), free_space(0) {}
+
+    void add(const CatalogEntry &e)
+    {
+      by_path[e.path] = entries.size();
+      entries.push_back(e);
+    }
+
+    const std::vector<CatalogEntry>& get_entries() const { return entries; }
+
+    size_t size() const { return entries.size(); }
+
+    // NULL if there is no object with this path
+    const CatalogEntry* find(const std::string &path) const
+    {
+      std::map<std::string, size_t>::const_iterator it = by_path.find(path);
+      return it == by_path.end() ? NULL : &entries[it->second];
+    }
+
+    std::vector<const CatalogEntry*> select(const std::function<bool (const CatalogEntry&)> &pred) const
+    {
+      std::vector<const CatalogEntry*> ret;
+      for (size_t i = 0; i < entries.size(); ++i)
+        if (pred(entries[i])) ret.push_back(&entries[i]);
+      return ret;
+    }
+
+    std::vector<const CatalogEntry*> datasets() const
+    {
+      return select([](const CatalogEntry &e) { return e.is_dataset(); });
+    }
+
+    void set_fingerprint(const File &file)
+    {
+      if (H5Fget_filesize(file.get_id(), &file_size) < 0)
+        throw Exception("cannot get size of file");
+      hssize_t fs = H5Fget_freespace(file.get_id());
+      if (fs < 0)
+        throw Exception("cannot get free space of file");
+      free_space = fs;
+    }
+
+    /*
+      True if file has the size and amount of free space it had when the catalog was built.
+      This is a cheap test which detects changes of the structure of a file, but not, e.g.,
+      data written in place.
+    */
+    bool matches(const File &file) const
+    {
+      Catalog tmp;
+      tmp.set_fingerprint(file);
+      return tmp.file_size == file_size && tmp.free_space == free_space;
+    }
+
+    // a line based text format. paths are escaped.
+    void write(std::ostream &os) const
+    {
+      os << "h5cpp_catalog 1 " << file_size << " " << free_space << " " << entries.size() << "\n";
+      for (size_t i = 0; i < entries.size(); ++i)
+      {
+        const CatalogEntry &e = entries[i];
+        os << escape(e.path) << " " << int(e.type) << " " << e.num_attrs << " " << int(e.type_class) << " " << e.type_size << " " << int(e.layout);
+        write_list(os, e.dims);
+        write_list(os, e.chunk_dims);
+        write_list(os, e.filters);
+        os << "\n";
+      }
+    }
+
+    static Catalog read(std::istream &is)
+    {
+      Catalog c;
+      std::string magic;
+      int version = 0;
+      size_t n = 0;
+      is >> magic >> version >> c.file_size >> c.free_space >> n;
+      if (!is || magic != "h5cpp_catalog" || version != 1)
+        throw Exception("not a catalog");
+      for (size_t i = 0; i < n; ++i)
+      {
+        CatalogEntry e;
+        std::string path;
+        int type, type_class, layout;
+        is >> path >> type >> e.num_attrs >> type_class >> e.type_size >> layout;
+        e.path = unescape(path);
+        e.type = H5O_type_t(type);
+        e.type_class = H5T_class_t(type_class);
+        e.layout = H5D_layout_t(layout);
+        read_list(is, e.dims);
+        read_list(is, e.chunk_dims);
+        read_list(is, e.filters);
+        if (!is)
+          throw Exception("error reading catalog");
+        c.add(e);
+      }
+      return c;
+    }
+
+  private:
+    template<class T>
+    static void write_list(std::ostream &os, const std::vector<T> &v)
+    {
+      os << " " << v.size();
+      for (size_t i = 0; i < v.size(); ++i)
+        os << " " << v[i];
+    }
+
+    template<class T>
+    static void read_list(std::istream &is, std::vector<T> &v)
+    {
+      size_t n = 0;
+      is >> n;
+      v.clear(); // no resize(n), a corrupt n must not allocate
+      T x;
+      for (size_t i = 0; i < n && is >> x; ++i)
+        v.push_back(x);
+    }
+
+    // replaces white space and % by %xx
+    static std::string escape(const std::string &s)
+    {
+      static const char hex[] = "0123456789abcdef";
+      std::string r;
+      for (size_t i = 0; i < s.size(); ++i)
+      {
+        unsigned char c = s[i];
+        if (c <= ' ' || c == '%' || c == 127)
+        {
+          r += '%';
+          r += hex[c >> 4];
+          r += hex[c & 15];
+        }
+        else
+          r += c;
+      }
+      return r;
+    }
+
+    static std::string unescape(const std::string &s)
+    {
+      std::string r;
+      for (size_t i = 0; i < s.size(); ++i)
+      {
+        if (s[i] == '%')
+        {
+          int hi = i + 2 < s.size() ? hex_digit(s[i + 1]) : -1, lo = hi >= 0 ? hex_digit(s[i + 2]) : -1;
+          if (lo < 0)
+            throw Exception("malformed path in catalog: " + s);
+          r += char(hi * 16 + lo);
+          i += 2;
+        }
+        else
+          r += s[i];
+      }
+      return r;
+    }
+
+    static int hex_digit(char c)
+    {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      return -1;
+    }
+};
+
+
+namespace internal
+{
+
+struct CatalogOp
+{
+  Group group;
+  Catalog *catalog;
+  std::string error;
+};
+
+inline herr_t catalog_object(hid_t, const char *name, const ObjectInfo *info, void *op_data)
+{
+  CatalogOp &op = *static_cast<CatalogOp*>(op_data);
+  try
+  {
+    CatalogEntry e;
+    e.path = name;
+    e.type = info->type;
+    e.num_attrs = info->num_attrs;
+    if (e.type == H5O_TYPE_DATASET)
+    {
+      Dataset ds = op.group.open_dataset(e.path);
+      Dataspace sp = ds.get_dataspace();
+      e.dims.resize(sp.get_rank());
+      if (!e.dims.empty())
+        sp.get_dims(&e.dims[0]);
+      Datatype dt = ds.get_datatype();
+      e.type_class = dt.get_class();
+      e.type_size = dt.get_size();
+      Properties dcpl = ds.get_creation_properties();
+      e.layout = dcpl.get_layout();
+      hsize_t cdims[H5S_MAX_RANK];
+      int r = dcpl.get_chunk(cdims);
+      e.chunk_dims.assign(cdims, cdims + r);
+      int nfilters = dcpl.get_nfilters();
+      for (int i = 0; i < nfilters; ++i)
+        e.filters.push_back(dcpl.get_filter(i));
+    }
+    else if (e.type == H5O_TYPE_NAMED_DATATYPE)
+    {
+      hid_t type_id = H5Topen2(op.group.get_id(), name, H5P_DEFAULT);
+      if (type_id < 0)
+        throw Exception("cannot open datatype: " + e.path);
+      Datatype dt(type_id, internal::NoIncRC());
+      e.type_class = dt.get_class();
+      e.type_size = dt.get_size();
+    }
+    op.catalog->add(e);
+  }
+  catch (const Exception &e)
+  {
+    op.error = e.what();
+    return -1;
+  }
+  return 0;
+}
+
+} // namespace internal
+
+
+/*
+  Collects the metadata of g and all objects below it in one traversal (H5Ovisit). Objects
+  reachable by several hard links are listed once, soft and external links are not followed.
+*/
+inline Catalog build_catalog(Group g)
+{
+  Catalog catalog;
+  internal::CatalogOp op = { g, &catalog, std::string() };
+#if H5_VERSION_GE(1,12,0)
+  herr_t err = H5Ovisit3(g.get_id(), H5_INDEX_NAME, H5_ITER_INC, internal::catalog_object, &op, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS);
+#elif H5_VERSION_GE(1,10,3)
+  herr_t err = H5Ovisit2(g.get_id(), H5_INDEX_NAME, H5_ITER_INC, internal::catalog_object, &op, H5O_INFO_BASIC | H5O_INFO_NUM_ATTRS);
+#else
+  herr_t err = H5Ovisit(g.get_id(), H5_INDEX_NAME, H5_ITER_INC, internal::catalog_object, &op);
+#endif
+  if (err < 0)
+    throw Exception(op.error.empty() ? std::string("error visiting objects") : op.error);
+  catalog.set_fingerprint(g.get_file());
+  return catalog;
+}
+
+
+/*--------------------------------------------------
+ *            Attributes
+ * ------------------------------------------------ */
+
+template<class T, class A>
+inline void set_array(Attributes attrs, const std::string &name, const std::vector<T, A> &data)
+{
+  attrs.set(name, Dataspace::simple_dims(data.size()), &data[0]);
+}
+
+template<class T>
+inline void set_array(Attributes attrs, const std::string &name, const T* data, hsize_t count)
+{
+  attrs.set(name, Dataspace::simple_dims(count), data);
+}
+
+// creates or replaces a one dimensional attribute of fixed length strings
+inline void set_array(Attributes attrs, const std::string &name, const FixedStrings &data)
+{
+  if (attrs.exists(name))
+    attrs.remove(name);
+  Datatype dt = data.get_datatype();
+  Attribute a = attrs.create(name, dt, internal::strings_space(data));
+  if (data.size() > 0)
+    a.write(dt, data.data());
+}
+
+template<class T>
+inline void set(Attributes attrs, const std::string &name, const T &value)
+{
+  attrs.set(name, Dataspace::scalar(), &value);
+}
+
+template<class T, class A>
+inline void get_array(Attributes attrs, const std::string &name, std::vector<T, A> &ret)
+{
+  Attribute a = attrs.open(name);
+  ret.resize(a.get_dataspace().get_npoints());
+  a.read<T>(&ret[0]);
+}
+
+// see read_dataset(const Dataset, FixedStrings&)
+inline void get_array(Attributes attrs, const std::string &name, FixedStrings &ret)
+{
+  internal::read_fixed_strings(attrs.open(name), ret, "attribute " + name);
+}
+
+template<class A>
+inline void get_array(Attributes attrs, const std::string &name, std::vector<std::string, A> &ret)
+{
+  Attribute a = attrs.open(name);
+  if (a.get_datatype().is_fixed_string())
+  {
+    FixedStrings tmp;
+    get_array(attrs, name, tmp);
+    tmp.to_strings(ret);
+    return;
+  }
+  ret.resize(a.get_dataspace().get_npoints());
+  a.read(&ret[0]);
+}
+
+template<class T>
+inline void get(Attributes attrs, const std::string &name, T &value)
+{
+  Attribute a = attrs.open(name);
+  assert(a.get_dataspace().get_npoints() == 1);
+  a.read<T>(&value);
+}
+
+
+/*
+  A set of attributes to be written at once by Attributes::set. The values are copied.
+*/
+class AttributeBatch
+{
+  public:
+    struct Entry
+    {
+      std::string name;
+      Datatype disktype;
+      Dataspace space;
+      std::function<void (Attribute&)> write; // writes the copied values
+    };
+
+    template<class T>
+    AttributeBatch& set(const std::string &name, Dataspace space, const T *values)
+    {
+      hssize_t n = space.get_npoints();
+      std::shared_ptr<T> copy(new T[n], std::default_delete<T[]>());
+      std::copy(values, values + n, copy.get());
+      Entry e = { name, internal::TypeRegistry<T>::disktype(), space, [copy](Attribute &a) { a.write(copy.get()); } };
+      entries.push_back(e);
+      return *this;
+    }
+
+    template<class T>
+    AttributeBatch& set(const std::string &name, const T &value)
+    {
+      return set(name, Dataspace::scalar(), &value);
+    }
+
+    AttributeBatch& set(const std::string &name, const char *value)
+    {
+      return set(name, std::string(value));
+    }
+
+    template<class T, class A>
+    AttributeBatch& set(const std::string &name, const std::vector<T, A> &values)
+    {
+      std::unique_ptr<T[]> tmp(new T[values.size()]); // not a std::vector, because of std::vector<bool>
+      std::copy(values.begin(), values.end(), tmp.get());
+      return set(name, Dataspace::simple_dims(values.size()), tmp.get());
+    }
+
+    size_t size() const { return entries.size(); }
+
+    const std::vector<Entry>& get_entries() const { return entries; }
+
+  private:
+    std::vector<Entry> entries;
+};
+
+
+/*
+  All attributes of an object, as read by Attributes::get_all. Numbers and compounds are stored in
+  the native type of the attribute and converted on access, strings are stored as std::string.
+*/
+class AttributeValues
+{
+  public:
+    struct Value
+    {
+      Datatype type;   // memory type of data
+      Dataspace space;
+      std::vector<char> data;
+      std::vector<std::string> strings; // instead of data, for attributes of string type
+    };
+
+    bool contains(const std::string &name) const { return values.find(name) != values.end(); }
+
+    size_t size() const { return values.size(); }
+
+    std::vector<std::string> get_names() const
+    {
+      std::vector<std::string> names;
+      for (std::map<std::string, Value>::const_iterator it = values.begin(); it != values.end(); ++it)
+        names.push_back(it->first);
+      return names;
+    }
+
+    const Value& at(const std::string &name) const
+    {
+      std::map<std::string, Value>::const_iterator it = values.find(name);
+      if (it == values.end())
+        throw NameLookupError(name);
+      return it->second;
+    }
+
+    // the first element, which is the only one for scalar attributes
+    template<class T>
+    T get(const std::string &name) const
+    {
+      std::vector<T> tmp;
+      get_array(name, tmp);
+      return tmp[0];
+    }
+
+    template<class T, class A>
+    void get_array(const std::string &name, std::vector<T, A> &ret) const
+    {
+      const Value &v = at(name);
+      hssize_t n = v.space.get_npoints();
+      std::unique_ptr<T[]> tmp(new T[n]); // not a std::vector, because of std::vector<bool>
+      convert(v, tmp.get());
+      ret.assign(tmp.get(), tmp.get() + n);
+    }
+
+    Value& insert(const std::string &name) { return values[name]; }
+
+  private:
+    std::map<std::string, Value> values;
+
+    template<class T>
+    static void convert(const Value &v, T *out)
+    {
+      if (!v.strings.empty())
+        throw Exception("cannot convert strings to other types");
+      const Datatype &memtype = internal::TypeRegistry<T>::memtype();
+      size_t n = v.space.get_npoints();
+      std::vector<char> buf(n * std::max(v.type.get_size(), memtype.get_size())); // conversion happens in place
+      std::memcpy(&buf[0], &v.data[0], v.data.size());
+      if (H5Tconvert(v.type.get_id(), memtype.get_id(), n, &buf[0], NULL, H5P_DEFAULT) < 0)
+        throw Exception("cannot convert attribute to the requested type");
+      std::memcpy(out, &buf[0], n * sizeof(T));
+    }
+
+    static void convert(const Value &v, std::string *out)
+    {
+      if (v.strings.empty())
+        throw Exception("attribute does not contain strings");
+      std::copy(v.strings.begin(), v.strings.end(), out);
+    }
+};
+
+
+namespace internal
+{
+
+// collects names and storage sizes of attributes
+inline herr_t collect_attribute_sizes(hid_t, const char *name, const H5A_info_t *info, void *op_data)
+{
+  (*static_cast<std::map<std::string, hsize_t>*>(op_data))[name] = info->data_size;
+  return 0;
+}
+
+struct ReadAttributesOp
+{
+  Attributes *attrs;
+  AttributeValues *values;
+  std::string error;
+};
+
+inline herr_t read_attribute(hid_t, const char *name, const H5A_info_t *, void *op_data)
+{
+  ReadAttributesOp &op = *static_cast<ReadAttributesOp*>(op_data);
+  try
+  {
+    Attribute a = op.attrs->open(name);
+    AttributeValues::Value &v = op.values->insert(name);
+    Datatype disktype = a.get_datatype();
+    v.space = a.get_dataspace();
+    hssize_t n = v.space.get_npoints();
+    if (disktype.get_class() == H5T_STRING)
+    {
+      v.strings.resize(n);
+      if (disktype.is_variable_length())
+        a.read(&v.strings[0]);
+      else
+      {
+        FixedStrings tmp;
+        Datatype memtype = Datatype::copy(disktype.get_id());
+        memtype.set_strpad(H5T_STR_NULLPAD);
+        tmp.resize(n, memtype.get_size());
+        a.read(memtype, tmp.data());
+        tmp.to_strings(v.strings);
+      }
+      v.type = disktype;
+    }
+    else
+    {
+      v.type = disktype.get_native();
+      v.data.resize(n * v.type.get_size());
+      a.read(v.type, &v.data[0]);
+    }
+  }
+  catch (const Exception &e)
+  {
+    op.error = e.what();
+    return -1;
+  }
+  return 0;
+}
+
+}
+
+
+inline void Attributes::set(const AttributeBatch &batch)
+{
+  std::map<std::string, hsize_t> existing;
+  hsize_t idx = 0;
+  if (H5Aiterate2(attributed_object.get_id(), H5_INDEX_NAME, H5_ITER_NATIVE, &idx, internal::collect_attribute_sizes, &existing) < 0)
+    throw Exception("error iterating over attributes");
+  const std::vector<AttributeBatch::Entry> &entries = batch.get_entries();
+  for (size_t i = 0; i < entries.size(); ++i)
+  {
+    const AttributeBatch::Entry &e = entries[i];
+    hsize_t nbytes = e.disktype.get_size() * e.space.get_npoints();
+    std::map<std::string, hsize_t>::iterator it = existing.find(e.name);
+    if (it != existing.end())
+    {
+      // a cheap test before looking closer. Variable length data is stored as heap references of another size
+      if (it->second == nbytes || e.disktype.is_variable_length())
+      {
+        Attribute a = open(e.name);
+        if (a.get_datatype().is_equal(e.disktype) && a.get_dataspace().is_extent_equal(e.space))
+        {
+          e.write(a);
+          continue;
+        }
+      }
+      remove(e.name);
+    }
+    Attribute a = create(e.name, e.disktype, e.space);
+    e.write(a);
+    existing[e.name] = nbytes;
+  }
+}
+
+
+inline void Attributes::get_all(AttributeValues &values)
+{
+  values = AttributeValues();
+  internal::ReadAttributesOp op = { this, &values, std::string() };
+  hsize_t idx = 0;
+  if (H5Aiterate2(attributed_object.get_id(), H5_INDEX_NAME, H5_ITER_NATIVE, &idx, internal::read_attribute, &op) < 0)
+    throw Exception(op.error.empty() ? std::string("error iterating over attributes") : op.error);
 }
 
 }
@@ -0,0 +1,234 @@
+/*
+  Microbenchmarks of the wrapper. Prints the time per operation and, on Linux, the number of
+  calls to the identifier functions of the hdf5 library (H5Iinc_ref, H5Idec_ref, H5Iis_valid, H5Iget_ref)
+  per operation. These are counted by wrapping the functions at link time, see CMakeLists.txt.
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+#include "hdf_wrapper.h"
+
+namespace h5 = h5cpp;
+using namespace std;
+
+#ifdef HDF_WRAPPER_COUNT_ID_CALLS
+static long id_calls = 0;
+
+extern "C"
+{
+int __real_H5Iinc_ref(hid_t id);
+int __real_H5Idec_ref(hid_t id);
+htri_t __real_H5Iis_valid(hid_t id);
+int __real_H5Iget_ref(hid_t id);
+
+int __wrap_H5Iinc_ref(hid_t id) { ++id_calls; return __real_H5Iinc_ref(id); }
+int __wrap_H5Idec_ref(hid_t id) { ++id_calls; return __real_H5Idec_ref(id); }
+htri_t __wrap_H5Iis_valid(hid_t id) { ++id_calls; return __real_H5Iis_valid(id); }
+int __wrap_H5Iget_ref(hid_t id) { ++id_calls; return __real_H5Iget_ref(id); }
+}
+#else
+static long id_calls = -1; // not counted
+#endif
+
+
+// runs op n times and prints the averages
+template<class F>
+void measure(const string &name, int n, F op)
+{
+  long calls0 = id_calls;
+  auto t0 = chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    op(i);
+  double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / n;
+  cout << left << setw(40) << name << right << setw(10) << fixed << setprecision(2) << us << " us";
+  if (id_calls >= 0)
+    cout << setw(10) << setprecision(1) << double(id_calls - calls0) / n << " id calls";
+  cout << endl;
+}
+
+
+void BenchmarkIdentifierCalls()
+{
+  cout << "-- identifier calls per operation --" << endl;
+  h5::File file("benchmark.h5", "w");
+  h5::Group root = file.root();
+  h5::Group g = root.create_group("objects");
+  vector<double> values(100, 1.);
+  h5::Dataset ds = h5::create_dataset(g, "values", values);
+  for (int i = 0; i < 100; ++i)
+    g.create_group("child" + to_string(i));
+  const int N = 2000;
+
+  measure("open dataset", N, [&](int) { h5::Dataset d = g.open_dataset("values"); });
+  measure("open dataset and read_dataset", N, [&](int) { h5::read_dataset(g.open_dataset("values"), values); });
+  measure("Dataset::read", N, [&](int) { ds.read(&values[0]); });
+  measure("Dataset::write", N, [&](int) { ds.write(&values[0]); });
+  measure("Dataset::get_dataspace().get_npoints()", N, [&](int) { ds.get_dataspace().get_npoints(); });
+  measure("create_dataset", N, [&](int i) { h5::create_dataset(root, "ds" + to_string(i), values, h5::CREATE_DS_0); });
+  measure("attrs().set<int>", N, [&](int i) { ds.attrs().set<int>("counter", i); });
+  measure("attrs().get<int>", N, [&](int) { ds.attrs().get<int>("counter"); });
+  measure("iteration over a group of 101 links", N / 100, [&](int) { for (h5::iterator it = g.begin(); it != g.end(); ++it) *it; });
+  measure("copy of a Dataset", N, [&](int) { h5::Dataset d(ds); });
+  vector<h5::Dataset> pushed;
+  measure("vector<Dataset>::push_back", N, [&](int) { pushed.push_back(g.open_dataset("values")); });
+}
+
+
+void BenchmarkPreparedIO()
+{
+  cout << "-- writing rows of 16 doubles --" << endl;
+  h5::File file("benchmark.h5", "w");
+  const int N = 20000;
+  h5::Dataset ds = h5::Dataset::create<double>(file.root(), "rows", h5::Dataspace::simple_dims(N, 16), h5::CREATE_DS_0);
+  double row[16] = {};
+  h5::Dataspace memsp = h5::Dataspace::simple_dims(16);
+  hsize_t count[2] = { 1, 16 };
+
+  measure("select_hyperslab and Dataset::write", N, [&](int i) {
+    h5::Dataspace filesp = ds.get_dataspace();
+    hsize_t offset[2] = { hsize_t(i), 0 };
+    filesp.select_hyperslab(offset, NULL, count, NULL);
+    ds.write(memsp, filesp, row);
+  });
+
+  h5::Dataspace filesp = ds.get_dataspace();
+  hsize_t offset[2] = { 0, 0 };
+  filesp.select_hyperslab(offset, NULL, count, NULL);
+  h5::WritePlan<double> plan = ds.prepare_write<double>(memsp, filesp);
+  measure("WritePlan::execute_at", N, [&](int i) {
+    hssize_t shift[2] = { i, 0 };
+    plan.execute_at(shift, row);
+  });
+}
+
+
+void BenchmarkConversionBuffer()
+{
+  cout << "-- reading 8M ints as doubles --" << endl;
+  h5::File file("benchmark.h5", "w");
+  vector<int> values(8 << 20, 1);
+  h5::Dataset ds = h5::create_dataset(file.root(), "ints", values, h5::CREATE_DS_0);
+  vector<double> converted(values.size());
+  h5::Properties large(H5P_DATASET_XFER);
+  large.conversion_buffer(16 << 20);
+
+  measure("1 MiB conversion buffer (default)", 5, [&](int) { ds.read(&converted[0]); });
+  measure("16 MiB conversion buffer", 5, [&](int) { ds.read(&converted[0], large); });
+}
+
+
+// MB/s of writing and reading n values of T
+template<class T>
+void measure_throughput(const string &name, h5::Group g, h5::DsCreationFlags flags, const h5::Datatype *memtype = NULL)
+{
+  const int n = 4 << 20, repeats = 5;
+  unique_ptr<T[]> values(new T[n]); // not a vector, because of vector<bool>
+  fill(values.get(), values.get() + n, T(1));
+  h5::Dataset ds = h5::Dataset::create<T>(g, name, h5::Dataspace::simple_dims(n), flags);
+  auto run = [&](bool write) -> double {
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i)
+    {
+      if (memtype && write) ds.write(*memtype, values.get());
+      else if (memtype) ds.read(*memtype, values.get());
+      else if (write) ds.write(values.get());
+      else ds.read(values.get());
+    }
+    double s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    return double(repeats) * n * sizeof(T) / s / (1 << 20);
+  };
+  double w = run(true), r = run(false);
+  cout << left << setw(40) << name << right << fixed << setprecision(0) << setw(10) << w << " MB/s write" << setw(10) << r << " MB/s read" << endl;
+}
+
+
+template<class T>
+void measure_byte_orders(const string &type_name, h5::Group g)
+{
+  measure_throughput<T>(type_name, g, h5::CREATE_DS_NATIVE_ORDER);
+  measure_throughput<T>(type_name + ", swapped", g, H5Tget_order(H5T_NATIVE_INT) == H5T_ORDER_LE ? h5::CREATE_DS_BIG_ENDIAN : h5::CREATE_DS_0);
+}
+
+
+void BenchmarkByteOrders()
+{
+  cout << "-- throughput with and without byte swapping --" << endl;
+  h5::File file("benchmark.h5", "w");
+  h5::Group g = file.root();
+  measure_throughput<char>("char", g, h5::CREATE_DS_NATIVE_ORDER); // single bytes have no order
+  measure_byte_orders<short>("short", g);
+  measure_byte_orders<int>("int", g);
+  measure_byte_orders<long long>("long long", g);
+  measure_byte_orders<float>("float", g);
+  measure_byte_orders<double>("double", g);
+  measure_throughput<bool>("bool", g, h5::CREATE_DS_0);
+  h5::Datatype signed_char = h5::Datatype::copy(H5T_NATIVE_SCHAR);
+  measure_throughput<bool>("bool, signed memory type", g, h5::CREATE_DS_0, &signed_char);
+}
+
+
+void BenchmarkChunkShapes()
+{
+  cout << "-- chunks of 10% (old) vs planned chunks, 2048 x 2048 doubles --" << endl;
+  h5::File file("benchmark.h5", "w");
+  const hsize_t N = 2048;
+  h5::Dataspace sp = h5::Dataspace::simple_dims(N, N);
+  vector<double> row(N, 1.), tile(256 * 256);
+  h5::Dataspace row_memsp = h5::Dataspace::simple_dims(N), tile_memsp = h5::Dataspace::simple_dims(256 * 256);
+  const h5::AccessPattern patterns[3] = { h5::ACCESS_ROWS, h5::ACCESS_COLUMNS, h5::ACCESS_TILES };
+  const char* pattern_names[3] = { "rows", "columns", "tiles" };
+  for (int k = 0; k < 3; ++k)
+  {
+    for (int planned = 0; planned < 2; ++planned)
+    {
+      h5::Properties prop(H5P_DATASET_CREATE);
+      if (planned) prop.chunked_for(sp, sizeof(double), patterns[k]);
+      else prop.chunked_with_estimated_size(sp);
+      string name = string(pattern_names[k]) + (planned ? ", planned" : ", 10%");
+      h5::Dataset ds = h5::Dataset::create(file.root(), name, h5::get_disktype<double>(), sp, prop);
+      h5::Dataspace filesp = ds.get_dataspace();
+      auto select = [&](int i) {
+        hsize_t offset[2] = { 0, 0 }, count[2] = { 1, N };
+        if (k == 0) offset[0] = i;
+        if (k == 1) { offset[1] = i; count[0] = N; count[1] = 1; }
+        if (k == 2) { offset[0] = 256 * (i / 8); offset[1] = 256 * (i % 8); count[0] = count[1] = 256; }
+        filesp.select_hyperslab(offset, NULL, count, NULL);
+        return k == 2 ? tile_memsp : row_memsp;
+      };
+      int n = k == 1 ? 256 : k == 0 ? N : 64;
+      measure("write " + name, n, [&](int i) { h5::Dataspace memsp = select(i); ds.write(memsp, filesp, k == 2 ? &tile[0] : &row[0]); });
+      measure("read " + name, n, [&](int i) { h5::Dataspace memsp = select(i); ds.read(memsp, filesp, k == 2 ? &tile[0] : &row[0]); });
+    }
+  }
+
+  hsize_t record_dims[2] = { 0, 64 };
+  h5::Dataspace series_sp = h5::Dataspace::simple_unlimited(2, record_dims);
+  double record[64] = {};
+  for (int planned = 0; planned < 2; ++planned)
+  {
+    h5::Properties prop(H5P_DATASET_CREATE);
+    if (planned) prop.chunked_for(series_sp, sizeof(double), h5::ACCESS_APPEND);
+    else prop.chunked_with_estimated_size(series_sp);
+    string name = string("append records of 64") + (planned ? ", planned" : ", 10%");
+    h5::Dataset ds = h5::Dataset::create(file.root(), name, h5::get_disktype<double>(), series_sp, prop);
+    h5::AppendWriter<double> writer(ds);
+    measure(name, 100000, [&](int) { writer.append(record); });
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  h5::disableAutoErrorReporting();
+  BenchmarkIdentifierCalls();
+  BenchmarkPreparedIO();
+  BenchmarkConversionBuffer();
+  BenchmarkByteOrders();
+  BenchmarkChunkShapes();
+  return 0;
+}
@@ -4,12 +4,68 @@
 #include <vector>
 #include <cmath>
 #include <list>
+#include <thread>
+#include <numeric>
 
 #include "hdf_wrapper.h"
 
 using namespace std;
 namespace h5 = h5cpp;
 
+struct Particle
+{
+  double x, y, z;
+  float m;
+  int id;
+};
+
+struct Record // with padding between members in memory
+{
+  char flag;
+  double value;
+  int counts[3];
+  char name[8];
+  Particle particle;
+};
+
+HDF5_WRAPPER_COMPOUND_BEGIN(Particle)
+  HDF5_WRAPPER_COMPOUND_MEMBER(x)
+  HDF5_WRAPPER_COMPOUND_MEMBER(y)
+  HDF5_WRAPPER_COMPOUND_MEMBER(z)
+  HDF5_WRAPPER_COMPOUND_MEMBER(m)
+  HDF5_WRAPPER_COMPOUND_MEMBER(id)
+HDF5_WRAPPER_COMPOUND_END()
+
+struct ParticlePosition // projection of Particle
+{
+  double z, x;
+};
+
+HDF5_WRAPPER_COMPOUND_BEGIN(ParticlePosition)
+  HDF5_WRAPPER_COMPOUND_MEMBER(z)
+  HDF5_WRAPPER_COMPOUND_MEMBER(x)
+HDF5_WRAPPER_COMPOUND_END()
+
+HDF5_WRAPPER_COMPOUND_BEGIN(Record)
+  HDF5_WRAPPER_COMPOUND_MEMBER(flag)
+  HDF5_WRAPPER_COMPOUND_MEMBER(value)
+  HDF5_WRAPPER_COMPOUND_MEMBER(counts)
+  HDF5_WRAPPER_COMPOUND_MEMBER(name)
+  HDF5_WRAPPER_COMPOUND_MEMBER(particle)
+HDF5_WRAPPER_COMPOUND_END()
+
+// a filter implemented here: flips bits of the stored bytes, which is its own inverse
+const H5Z_filter_t XOR_FILTER = 300;
+
+size_t XorFilter(unsigned int flags, size_t cd_nelmts, const unsigned int cd_values[], size_t nbytes, size_t *buf_size, void **buf)
+{
+  unsigned char mask = cd_nelmts > 0 ? cd_values[0] : 0xff;
+  unsigned char *p = static_cast<unsigned char*>(*buf);
+  for (size_t i = 0; i < nbytes; ++i)
+    p[i] ^= mask;
+  return nbytes;
+}
+
 void WriteFile()
 {
   cout << "=== Writing ===" << endl;
@@ -25,6 +81,16 @@ void WriteFile()
     cout << "dt ref count = " << dt.get_ref() << endl;
     assert (dt.get_ref() == 2);  // one for cached instance, and another reference accounting for the dt variable here.
   }
+  {
+    h5::Datatype dt = h5::get_disktype<int>();
+    h5::Datatype moved(std::move(dt)); // takes over the reference
+    assert(moved.get_ref() == 2 && dt.get_id() < 0);
+    dt = std::move(moved);
+    assert(dt.get_ref() == 2);
+    h5::Datatype other = h5::get_disktype<int>();
+    other = std::move(dt); // both referred to the same type
+    assert(other.get_ref() == 2);
+  }
   
   cout << "-- group management and attribute R/W tests --" << endl;
   
@@ -61,6 +127,10 @@ void WriteFile()
   a.set<string>("attrib_overwrite_test1", "erased and recreated!");
   a.set<int>("attrib_overwrite_test2", 3); // should just write into the existing space
   a.set<unsigned long>("longer int type", 1234567890);
+  std::error_code ec;
+  a.set("attrib_overwrite_test2", 4, ec); // written in place
+  a.set("set_with_error_code", 2.5, ec);
+  assert(!ec && a.get<int>("attrib_overwrite_test2") == 4 && a.get<double>("set_with_error_code") == 2.5);
   
   // try to make a group and set some attributes
   h5::Group g = root.create_group("testing_the_group");
@@ -170,6 +240,354 @@ void WriteFile()
     sp.select_hyperslab(offset, stride, count, block);
     ds.write(memsp, sp, &memdata[0]);  // writes to [1 .. 5] x [1 .. 1]
   }
+
+  cout << "-- extensible datasets --" << endl;
+  {
+    hsize_t dims[2] = { 0, 3 };
+    h5::Dataset ds = h5::Dataset::create<int>(root, "append_test_ds", h5::Dataspace::simple_unlimited(2, dims));
+    assert(ds.get_dataspace().is_extensible());
+    h5::AppendWriter<int> writer(ds, 16); // flush every 16 records
+    assert(writer.get_record_size() == 3);
+    for (int i = 0; i < 100; ++i)
+    {
+      int record[3] = { i, 2*i, 3*i };
+      writer.append(record);
+    }
+    assert(writer.size() == 100);
+    writer.flush();
+    ds.get_dataspace().get_dims(dims);
+    assert(dims[0] == 100 && dims[1] == 3);
+
+    hsize_t empty = 0;
+    h5::AppendWriter<double> series(h5::Dataset::create<double>(root, "append_test_series", h5::Dataspace::simple_unlimited(1, &empty)));
+    for (int i = 0; i < 1000; ++i)
+      series.append(0.5 * i);
+
+    h5::Properties twice(H5P_DATASET_XFER);
+    twice.data_transform("2*x");
+    {
+      h5::AppendWriter<int> scaled(h5::Dataset::create<int>(root, "append_test_scaled", h5::Dataspace::simple_unlimited(1, &empty)), 4, twice);
+      for (int i = 0; i < 10; ++i)
+        scaled.append(i);
+    }
+    vector<int> scaled;
+    h5::read_dataset(root.open_dataset("append_test_scaled"), scaled);
+    assert(scaled.size() == 10 && scaled[9] == 18);
+  } // series is flushed in the destructor
+
+  cout << "-- chunk cache --" << endl;
+  {
+    vector<int> field(200*200);
+    for (size_t i = 0; i < field.size(); ++i)
+      field[i] = i;
+    h5::create_dataset(root, "chunk_cache_test_ds", h5::Dataspace::simple_dims(200, 200), &field[0], h5::CREATE_DS_COMPRESSED);
+  }
+
+  cout << "-- parallel chunk I/O --" << endl;
+  {
+    h5::Dataspace sp = h5::Dataspace::simple_dims(60, 50, 40);
+    vector<double> field(60*50*40);
+    for (size_t i = 0; i < field.size(); ++i)
+      field[i] = sin(i * 0.001);
+    h5::create_dataset(root, "parallel_deflate_ds", sp, &field[0], h5::CREATE_DS_COMPRESSED);
+
+    h5::Properties prop(H5P_DATASET_CREATE);
+    hsize_t cdims[3] = { 32, 32, 32 }; // 8 chunks
+    prop.chunked(3, cdims);
+    H5Pset_shuffle(prop.get_id());
+    prop.deflate(4);
+    H5Pset_fletcher32(prop.get_id());
+    h5::Dataset ds = h5::Dataset::create(root, "parallel_filters_ds", h5::get_disktype<double>(), sp, prop);
+    ds.write(&field[0]);
+
+    // only the first chunk is written, the others must read as fill value
+    ds = h5::Dataset::create<double>(root, "parallel_sparse_ds", sp, h5::CREATE_DS_COMPRESSED);
+    h5::Dataspace filesp = ds.get_dataspace();
+    hsize_t offset[3] = { 0, 0, 0 }, count[3] = { 2, 2, 2 };
+    filesp.select_hyperslab(offset, NULL, count, NULL);
+    double values[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    ds.write(h5::Dataspace::simple_dims(8), filesp, values);
+
+    // parallel compression. the second dataset gets incompressible data, so deflate must be skipped for its chunks.
+    ds = h5::Dataset::create(root, "parallel_write_ds", h5::get_disktype<double>(), sp, prop);
+    h5::ChunkIOStats stats = h5::write_dataset_parallel(ds, field, 3);
+    cout << "parallel write: " << stats.chunks << " chunks, ratio " << stats.compression_ratio() << ", " << stats.throughput() / 1.e6 << " MB/s" << endl;
+    assert(stats.threads == 3 && stats.chunks == 8);
+    vector<unsigned char> noise(100000);
+    unsigned int state = 12345;
+    for (size_t i = 0; i < noise.size(); ++i)
+    {
+      state = state * 1103515245u + 12345u;
+      noise[i] = (unsigned char)(state >> 16);
+    }
+    ds = h5::Dataset::create<unsigned char>(root, "parallel_write_noise_ds", h5::Dataspace::simple_dims(noise.size()), h5::CREATE_DS_COMPRESSED);
+    h5::write_dataset_parallel(ds, noise);
+  }
+
+  cout << "-- fixed length strings --" << endl;
+  {
+    vector<string> ids(10000);
+    for (size_t i = 0; i < ids.size(); ++i)
+      ids[i] = "id" + std::to_string(i*7);
+    h5::FixedStrings fixed(ids); // width is determined from the longest string
+    assert(fixed.get_width() == 7 && fixed.size() == ids.size());
+    h5::create_dataset(root, "fixed_strings_ds", fixed);
+    h5::create_dataset(root, "variable_strings_ds", ids);
+    h5::set_array(root.attrs(), "fixed_strings_attr", h5::FixedStrings(ids, 4)); // truncated to 4 characters
+    h5::create_dataset(root, "no_fixed_strings_ds", h5::FixedStrings());
+    hsize_t none = 0, one = 1;
+    h5::Dataset::create<string>(root, "no_variable_strings_ds", h5::Dataspace::simple(1, &none, &one));
+  }
+
+  cout << "-- compound types --" << endl;
+  {
+    vector<Particle> particles(1000);
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+      Particle p = { 1.*i, 2.*i, 3.*i, 0.5f*i, (int)i };
+      particles[i] = p;
+    }
+    h5::create_dataset(root, "particles", particles);
+
+    assert(h5::get_memtype<Record>().get_size() == sizeof(Record));
+    assert(h5::get_disktype<Record>().get_size() == 1 + 8 + 12 + 8 + 32); // packed
+    Record r = { 'x', 3.5, { 1, 2, 3 }, "record", particles[7] };
+    h5::create_dataset_scalar(root, "record", r);
+    root.attrs().set("record_attr", r);
+  }
+
+  cout << "-- memory mapped datasets --" << endl;
+  {
+    vector<double> field(100*50);
+    for (size_t i = 0; i < field.size(); ++i)
+      field[i] = 0.25 * i;
+    h5::create_dataset(root, "mapped_ds", h5::Dataspace::simple_dims(100, 50), &field[0], h5::CREATE_DS_0); // for the reading tests below
+
+    h5::Properties fapl(H5P_FILE_ACCESS);
+    fapl.alignment(4096, 64); // mapping needs storage aligned for the element type
+    h5::File mapped("test_mapped.h5", "w", fapl);
+    h5::Dataset ds = h5::create_dataset(mapped.root(), "mapped_ds", h5::Dataspace::simple_dims(100, 50), &field[0], h5::CREATE_DS_0);
+    h5::MappedArray<double> view = ds.map<double>(); // the file is flushed before mapping
+    assert(view.size() == field.size() && view(99, 49) == field.back());
+  }
+
+  cout << "-- in memory files --" << endl;
+  {
+    h5::File memfile = h5::File::in_memory("never_on_disk.h5");
+    h5::create_dataset(memfile.root(), "values", data);
+    memfile.root().attrs().set("origin", "memory");
+    vector<char> image = memfile.get_image();
+    memfile.close();
+    assert(H5Fis_hdf5("never_on_disk.h5") <= 0);
+    h5::create_dataset(root, "file_image", image); // e.g. shipped over IPC
+
+    h5::File backed = h5::File::in_memory("test_backed.h5", "w", true); // written to disk on close
+    h5::create_dataset(backed.root(), "values", data);
+  }
+
+  cout << "-- attribute batches --" << endl;
+  {
+    h5::Group bg = root.create_group("attribute_batch_group");
+    h5::AttributeBatch batch;
+    for (int i = 0; i < 50; ++i)
+      batch.set("attr" + std::to_string(i), i);
+    batch.set("name", "batch").set("scale", 0.5).set("values", data).set("particle", Particle{ 1., 2., 3., 4.f, 5 });
+    bg.attrs().set(batch);
+    h5::AttributeBatch changes;
+    changes.set("attr0", 100).set("attr1", 1.5).set("name", "overwritten").set("extra", true);
+    bg.attrs().set(changes); // attr0 is overwritten in place, attr1 and name are replaced
+    assert(bg.attrs().size() == 55);
+
+    hid_t gcpl = H5Pcreate(H5P_GROUP_CREATE); // to tell whether attributes were recreated
+    H5Pset_attr_creation_order(gcpl, H5P_CRT_ORDER_TRACKED);
+    H5Gclose(H5Gcreate2(root.get_id(), "attribute_order_group", H5P_DEFAULT, gcpl, H5P_DEFAULT));
+    H5Pclose(gcpl);
+    h5::Group og = root.open_group("attribute_order_group");
+    og.attrs().set(h5::AttributeBatch().set("label", "first").set("count", 1));
+    og.attrs().set(h5::AttributeBatch().set("label", "a longer second").set("count", 2));
+    H5A_info_t info;
+    H5Aget_info_by_name(og.get_id(), ".", "label", &info, H5P_DEFAULT);
+    assert(info.corder_valid && info.corder == 0); // the string was rewritten in place
+    assert(og.attrs().get<string>("label") == "a longer second");
+  }
+
+  cout << "-- group listings --" << endl;
+  {
+    h5::Group lg = root.create_group("listing_group", true); // tracks creation order
+    h5::create_dataset(lg, "zeta", data);
+    lg.create_group("alpha");
+    h5::create_dataset(lg, "mid", data);
+    H5Lcreate_soft("alpha", lg.get_id(), "link_to_alpha", H5P_DEFAULT, H5P_DEFAULT);
+  }
+
+  cout << "-- selections --" << endl;
+  {
+    vector<int> zeros(20*20);
+    h5::Dataset ds = h5::create_dataset(root, "selection_ds", h5::Dataspace::simple_dims(20, 20), &zeros[0]);
+    h5::Selection tiles(ds);
+    for (hsize_t i = 0; i < 20; i += 5) // the diagonal of 2x2 tiles, one write
+    {
+      hsize_t offset[2] = { i, i }, count[2] = { 2, 2 };
+      tiles.add_block(offset, count);
+    }
+    assert(tiles.get_npoints() == 16);
+    tiles.write(ds, vector<int>(16, 1));
+  }
+
+  cout << "-- blocks of arrays in memory --" << endl;
+  {
+    // a 4 x 5 domain with one layer of ghost cells
+    hsize_t extent[2] = { 6, 7 }, offset[2] = { 1, 1 }, count[2] = { 4, 5 };
+    vector<float> domain(6*7, -1.f);
+    for (int y = 0; y < 4; ++y) for (int x = 0; x < 5; ++x)
+      domain[(y+1)*7 + x+1] = 10.f*y + x;
+    h5::Dataset ds = h5::Dataset::create<float>(root, "ghost_domain_ds", h5::Dataspace::simple(2, count));
+    ds.write(h5::ArrayBlock(2, extent, offset, count), &domain[0]);
+  }
+
+  cout << "-- prepared I/O --" << endl;
+  {
+    h5::Dataset ds = h5::Dataset::create<int>(root, "prepared_ds", h5::Dataspace::simple_dims(1000, 10));
+    h5::Dataspace filesp = ds.get_dataspace();
+    hsize_t offset[2] = { 0, 0 }, count[2] = { 1, 10 };
+    filesp.select_hyperslab(offset, NULL, count, NULL); // the first row
+    h5::WritePlan<int> plan = ds.prepare_write<int>(h5::Dataspace::simple_dims(10), filesp);
+    int row[10];
+    for (int i = 0; i < 1000; ++i)
+    {
+      for (int j = 0; j < 10; ++j)
+        row[j] = 10 * i + j;
+      hssize_t shift[2] = { i, 0 };
+      plan.execute_at(shift, row);
+    }
+  }
+
+  cout << "-- transfer properties --" << endl;
+  {
+    vector<int> values(1<<19); // 2 MiB, more than the default conversion buffer
+    std::iota(values.begin(), values.end(), 0);
+    h5::create_dataset(root, "converted_ds", values);
+    h5::Properties xfer(H5P_DATASET_XFER);
+    xfer.data_transform("x+1").hyper_vector_size(4096);
+    h5::Dataset ds = h5::Dataset::create<int>(root, "transformed_ds", h5::Dataspace::simple_dims(100));
+    ds.write(&values[0], xfer);
+  }
+
+  cout << "-- byte order of disk types --" << endl;
+  {
+    vector<double> values(100);
+    std::iota(values.begin(), values.end(), 0.5);
+    h5::create_dataset(root, "big_endian_ds", values, h5::CREATE_DS_BIG_ENDIAN);
+    h5::create_dataset(root, "native_order_ds", values, h5::CREATE_DS_NATIVE_ORDER);
+    vector<Particle> particles(10);
+    for (int i = 0; i < 10; ++i)
+    {
+      Particle p = { 1.*i, 2.*i, 3.*i, 0.5f*i, i };
+      particles[i] = p;
+    }
+    h5::create_dataset(root, "big_endian_particles", particles, h5::CREATE_DS_BIG_ENDIAN);
+    bool flags[3] = { true, false, true };
+    h5::create_dataset(root, "bool_ds", h5::Dataspace::simple_dims(3), flags);
+    h5::Datatype color(H5Tenum_create(H5T_NATIVE_INT));
+    int red = 0;
+    H5Tenum_insert(color.get_id(), "red", &red);
+    h5::Datatype same_color = h5::internal::with_byte_order(color, H5T_ORDER_BE); // enums keep their order
+    assert(H5Tequal(same_color.get_id(), color.get_id()) > 0);
+  }
+
+  cout << "-- filters --" << endl;
+  {
+    vector<float> field(10000);
+    for (size_t i = 0; i < field.size(); ++i)
+      field[i] = std::sin(0.01f * i);
+    h5::create_dataset(root, "shuffled_ds", field, h5::CREATE_DS_SHUFFLE | h5::CREATE_DS_COMPRESSED | h5::CREATE_DS_FLETCHER32);
+
+    vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 1000);
+    h5::Dataspace sp = h5::Dataspace::simple_dims(values.size());
+    hsize_t chunk = 100;
+    h5::Properties dcpl(H5P_DATASET_CREATE);
+    dcpl.chunked(1, &chunk).scaleoffset(H5Z_SO_INT, H5Z_SO_INT_MINBITS_DEFAULT);
+    h5::Dataset::create(root, "scaleoffset_ds", h5::get_disktype<int>(), sp, dcpl).write(&values[0]);
+
+    H5Z_class2_t xor_class = { H5Z_CLASS_T_VERS, XOR_FILTER, 1, 1, "xor", NULL, NULL, XorFilter };
+    assert(!h5::is_filter_available(XOR_FILTER));
+    h5::register_filter(xor_class);
+    assert(h5::is_filter_available(XOR_FILTER));
+    h5::Properties xor_dcpl(H5P_DATASET_CREATE);
+    xor_dcpl.chunked(1, &chunk).filter(XOR_FILTER, H5Z_FLAG_MANDATORY, vector<unsigned int>(1, 0x5a));
+    h5::Dataset::create(root, "xor_ds", h5::get_disktype<int>(), sp, xor_dcpl).write(&values[0]);
+
+    try
+    {
+      h5::Properties(H5P_DATASET_CREATE).filter(XOR_FILTER + 1);
+      assert(false);
+    }
+    catch (const h5::Exception &) {}
+    h5::Properties(H5P_DATASET_CREATE).filter(XOR_FILTER + 1, H5Z_FLAG_OPTIONAL); // skipped when writing
+  }
+
+  cout << "-- chunk planning --" << endl;
+  {
+    hsize_t cdims[3];
+    assert(h5::plan_chunk_dims(h5::Dataspace::simple_dims(2000, 2000, 2000), 8, cdims) == 3);
+    hsize_t bytes = cdims[0] * cdims[1] * cdims[2] * 8;
+    assert(bytes <= HDF_WRAPPER_CHUNK_TARGET_BYTES && bytes > HDF_WRAPPER_CHUNK_TARGET_BYTES / 8);
+    h5::plan_chunk_dims(h5::Dataspace::simple_dims(10, 10), 8, cdims);
+    assert(cdims[0] == 10 && cdims[1] == 10); // not padded
+    h5::plan_chunk_dims(h5::Dataspace::simple_dims(2048, 2048), 8, cdims, h5::ACCESS_ROWS, 1<<18);
+    assert(cdims[0] == 16 && cdims[1] == 2048);
+    h5::plan_chunk_dims(h5::Dataspace::simple_dims(2048, 2048), 8, cdims, h5::ACCESS_COLUMNS, 1<<18);
+    assert(cdims[0] == 2048 && cdims[1] == 16);
+    hsize_t record[2] = { 0, 64 };
+    h5::Dataspace series = h5::Dataspace::simple_unlimited(2, record);
+    h5::plan_chunk_dims(series, 8, cdims, h5::ACCESS_APPEND, 1<<18);
+    assert(cdims[0] == 512 && cdims[1] == 64);
+    h5::plan_chunk_dims(series, 8, cdims, h5::ACCESS_ANY, 1<<18);
+    assert(cdims[0] * cdims[1] <= 1<<15 && cdims[1] == 64);
+
+    h5::Dataset ds = h5::Dataset::create<float>(root, "column_chunks_ds", h5::Dataspace::simple_dims(1000, 100), h5::CREATE_DS_CHUNKED, h5::ACCESS_COLUMNS);
+    assert(ds.get_creation_properties().get_chunk(cdims) == 2 && cdims[0] == 1000 && cdims[1] == 65);
+  }
+
+  cout << "-- block decomposition --" << endl;
+  {
+    // as if each of 6 processes wrote its block of the global array
+    hsize_t global[2] = { 10, 7 };
+    h5::Dataset ds = h5::Dataset::create<int>(root, "decomposed_ds", h5::Dataspace::simple(2, global));
+    hsize_t total = 0;
+    for (int proc = 0; proc < 6; ++proc)
+    {
+      h5::BlockDecomposition block(2, global, 6, proc);
+      assert(block.get_grid()[0] == 3 && block.get_grid()[1] == 2);
+      vector<int> local;
+      for (hsize_t y = 0; y < block.get_count()[0]; ++y)
+        for (hsize_t x = 0; x < block.get_count()[1]; ++x)
+          local.push_back((block.get_offset()[0] + y) * 7 + block.get_offset()[1] + x);
+      h5::Dataspace filesp = ds.get_dataspace();
+      block.select(filesp);
+      ds.write(block.get_mem_space(), filesp, &local[0]);
+      total += block.get_npoints();
+    }
+    assert(total == 70);
+
+    hsize_t few[1] = { 3 };
+    ds = h5::Dataset::create<int>(root, "decomposed_few_ds", h5::Dataspace::simple(1, few));
+    for (int proc = 0; proc < 5; ++proc) // more processes than elements
+    {
+      h5::BlockDecomposition block(1, few, 5, proc);
+      assert(block.get_npoints() == (proc < 3 ? 1 : 0));
+      h5::Dataspace filesp = ds.get_dataspace();
+      block.select(filesp);
+      int value = proc;
+      ds.write(block.get_mem_space(), filesp, &value);
+    }
+
+    int bad_grid[2] = { -2, -3 }; // the product matches 6 processes
+    bool failed = false;
+    try { h5::BlockDecomposition(2, global, 6, 0, bad_grid); } catch (const h5::Exception &) { failed = true; }
+    assert(failed);
+  }
 }
 
 #if 1
@@ -276,6 +694,497 @@ void ReadFile()
       printf("(%i, %i) = %i\n", x, y, value);
       assert(value == expected_value[x][y]);
     }
+
+  cout << "-- extensible datasets --" << endl;
+  {
+    ds = root.open_dataset("append_test_ds");
+    vector<int> data; h5::read_dataset<int>(ds, data);
+    assert(data.size() == 300);
+    for (int i = 0; i < 100; ++i)
+      assert(data[3*i] == i && data[3*i+1] == 2*i && data[3*i+2] == 3*i);
+    vector<double> series; h5::read_dataset<double>(root.open_dataset("append_test_series"), series);
+    assert(series.size() == 1000 && series[999] == 0.5 * 999);
+  }
+
+  cout << "-- chunk cache --" << endl;
+  {
+    h5::ChunkCache caches[2] = { h5::ChunkCache(1024), h5::ChunkCache::automatic_size() };
+    size_t nbytes[2];
+    for (int k = 0; k < 2; ++k)
+    {
+      ds = root.open_dataset("chunk_cache_test_ds", caches[k]);
+      h5::Dataspace filesp = ds.get_dataspace();
+      h5::Dataspace memsp = h5::Dataspace::simple_dims(200);
+      vector<int> row(200);
+      for (hsize_t y = 0; y < 200; ++y)
+      {
+        hsize_t offset[2] = { y, 0 };
+        hsize_t count[2] = { 1, 200 };
+        filesp.select_hyperslab(offset, NULL, count, NULL);
+        ds.read(memsp, filesp, &row[0]);
+        assert(row[199] == int(y*200 + 199));
+      }
+      h5::ChunkCache c = ds.get_chunk_cache();
+      nbytes[k] = c.nbytes;
+      cout << "cache of " << c.nbytes << " bytes, " << c.nslots << " slots" << endl;
+      ds = h5::Dataset(); // close, so that the next open applies its cache settings
+    }
+    assert(nbytes[0] == 1024);
+    assert(nbytes[1] >= 200 * 200 * sizeof(int)); // the whole dataset is a single chunk, which must fit
+  }
+
+  cout << "-- parallel chunk I/O --" << endl;
+  {
+    const char* names[3] = { "parallel_deflate_ds", "parallel_filters_ds", "parallel_sparse_ds" };
+    for (int k = 0; k < 3; ++k)
+    {
+      ds = root.open_dataset(names[k]);
+      vector<double> expected, data;
+      h5::read_dataset(ds, expected);
+      h5::ChunkIOStats stats = h5::read_dataset_parallel(ds, data, 4);
+      h5::Properties unchecked(H5P_DATASET_XFER);
+      unchecked.edc_check(false);
+      vector<double> unchecked_data;
+      h5::read_dataset_parallel(ds, unchecked_data, unchecked, 2);
+      assert(unchecked_data == expected);
+      cout << names[k] << ": " << stats.chunks << " chunks, " << stats.threads << " threads, ratio " << stats.compression_ratio() << endl;
+      assert(stats.threads == 4 && stats.chunks > 0);
+      assert(data == expected);
+    }
+    // chunks written directly must be readable through the library filter pipeline
+    vector<double> expected, data;
+    h5::read_dataset(root.open_dataset("parallel_deflate_ds"), expected);
+    h5::read_dataset(root.open_dataset("parallel_write_ds"), data);
+    assert(data == expected);
+    vector<unsigned char> noise;
+    h5::read_dataset(root.open_dataset("parallel_write_noise_ds"), noise);
+    unsigned int state = 12345;
+    for (size_t i = 0; i < noise.size(); ++i)
+    {
+      state = state * 1103515245u + 12345u;
+      assert(noise[i] == (unsigned char)(state >> 16));
+    }
+  }
+
+  cout << "-- concurrent reads --" << endl;
+  {
+    const bool threadsafe = h5::is_library_threadsafe();
+    cout << "thread safe library: " << threadsafe << endl;
+    h5::Dataset bigdata = root.open_group("testing_the_group").open_dataset("bigdata");
+    vector<double> expected; h5::read_dataset(bigdata, expected);
+    vector<int> ok(4, 0);
+    vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+      threads.push_back(std::thread([&, t]()
+      {
+        for (int k = 0; k < 10; ++k)
+        {
+          vector<double> data(expected.size());
+          if (threadsafe)
+            bigdata.read(&data[0]);
+          else
+          {
+            h5::LibraryLock lock;
+            bigdata.read(&data[0]);
+          }
+          ok[t] += (data == expected);
+        }
+      }));
+    }
+    for (int t = 0; t < 4; ++t)
+      threads[t].join();
+    for (int t = 0; t < 4; ++t)
+      assert(ok[t] == 10);
+  }
+
+  cout << "-- fixed length strings --" << endl;
+  {
+    h5::FixedStrings fixed;
+    h5::read_dataset(root.open_dataset("fixed_strings_ds"), fixed);
+    assert(fixed.size() == 10000 && fixed.get_width() == 7);
+    assert(fixed[3] == string("id21") && fixed.str(9999) == "id69993");
+    vector<string> ids;
+    h5::read_dataset(root.open_dataset("fixed_strings_ds"), ids);
+    assert(ids.size() == 10000 && ids[3] == "id21");
+    h5::read_dataset(root.open_dataset("variable_strings_ds"), fixed); // variable length strings are packed
+    assert(fixed[9999] == string("id69993"));
+    h5::get_array(root.attrs(), "fixed_strings_attr", ids);
+    assert(ids.size() == 10000 && ids[0] == "id0" && ids[9999] == "id69");
+    h5::read_dataset(root.open_dataset("no_fixed_strings_ds"), fixed);
+    assert(fixed.size() == 0);
+    h5::read_dataset(root.open_dataset("no_variable_strings_ds"), fixed);
+    assert(fixed.size() == 0);
+
+    h5::Dataset strings_ds = root.open_dataset("variable_strings_ds");
+    h5::Selection none(strings_ds);
+    none.read(strings_ds, &ids[0], h5::Properties(H5P_DATASET_XFER)); // nothing to transfer
+    assert(ids[0] == "id0");
+
+    hsize_t padded = 10002, offset = 1, count = 10000;
+    vector<string> framed(padded, "frame");
+    strings_ds.read(h5::ArrayBlock(1, &padded, &offset, &count), &framed[0]);
+    assert(framed[0] == "frame" && framed[1] == "id0" && framed[10000] == "id69993" && framed[10001] == "frame");
+  }
+
+  cout << "-- variable length strings in an arena --" << endl;
+  {
+    h5::VlenArena arena;
+    vector<h5::StringRef> refs;
+    h5::read_dataset(root.open_dataset("variable_strings_ds"), arena, refs);
+    assert(refs.size() == 10000 && refs[3] == string("id21") && refs[9999] == string("id69993"));
+    cout << arena.get_allocations() << " allocations in " << arena.get_blocks() << " blocks" << endl;
+    assert(arena.get_allocations() == 10000 && arena.get_blocks() == 1);
+  }
+
+  cout << "-- compound types --" << endl;
+  {
+    vector<Particle> particles;
+    h5::read_dataset(root.open_dataset("particles"), particles);
+    assert(particles.size() == 1000);
+    assert(particles[10].x == 10. && particles[10].z == 30. && particles[10].m == 5.f && particles[10].id == 10);
+    Record r;
+    root.open_dataset("record").read(&r);
+    assert(r.flag == 'x' && r.value == 3.5 && r.counts[2] == 3 && string(r.name) == "record" && r.particle.id == 7);
+    Record ra = root.attrs().get<Record>("record_attr");
+    assert(ra.particle.y == 14.);
+  }
+
+  cout << "-- projections of compound datasets --" << endl;
+  {
+    ds = root.open_dataset("particles");
+    vector<double> xs;
+    vector<int> ids;
+    vector<float> masses;
+    h5::Projection(ds).field("x", xs).read();
+    assert(xs.size() == 1000 && xs[5] == 5.);
+    h5::Projection(ds).field("id", ids).field("m", masses).read();
+    assert(ids[999] == 999 && masses[999] == 0.5f*999);
+    vector<ParticlePosition> positions;
+    h5::read_projected(ds, positions);
+    assert(positions.size() == 1000 && positions[3].x == 3. && positions[3].z == 9.);
+    bool failed = false;
+    try
+    {
+      h5::Projection(ds).field("no_such_field", xs);
+    }
+    catch (const h5::NameLookupError &)
+    {
+      failed = true;
+    }
+    assert(failed);
+  }
+
+  cout << "-- memory mapped datasets --" << endl;
+  {
+    h5::MappedArray<double> view = h5::File("test_mapped.h5", "r").root().open_dataset("mapped_ds").map<double>(); // keeps the file open
+    assert(view.get_rank() == 2 && view.get_dim(0) == 100 && view.get_dim(1) == 50);
+    assert(view[7] == 1.75 && view(2, 3) == 0.25 * 103);
+    double sum = 0.;
+    for (const double *p = view.begin(); p != view.end(); ++p)
+      sum += *p;
+    assert(sum == 0.25 * 4999 * 5000 / 2);
+    bool failed = false;
+    try
+    {
+      root.open_group("testing_the_group").open_dataset("bigdata").map<double>(); // compressed
+    }
+    catch (const h5::Exception &)
+    {
+      failed = true;
+    }
+    assert(failed);
+  }
+
+  cout << "-- in memory files --" << endl;
+  {
+    vector<char> image;
+    h5::read_dataset(root.open_dataset("file_image"), image);
+    h5::File memfile = h5::File::from_image(&image[0], image.size());
+    vector<float> values;
+    h5::read_dataset(memfile.root().open_dataset("values"), values);
+    assert(values.size() == 10 && values[3] == 9.f);
+    assert(memfile.root().attrs().get<string>("origin") == "memory");
+    assert(memfile.get_image().size() == image.size());
+
+    h5::File backed("test_backed.h5", "r");
+    h5::read_dataset(backed.root().open_dataset("values"), values);
+    assert(values.size() == 10 && values[9] == 81.f);
+  }
+
+  cout << "-- prefetching block reads --" << endl;
+  {
+    ds = root.open_dataset("mapped_ds");
+    vector<double> field;
+    h5::read_dataset(ds, field);
+    h5::BlockReader<double> reader(ds, 7); // 100 rows, the last block is shorter
+    assert(reader.get_num_blocks() == 15 && reader.get_row_size() == 50);
+    assert(reader.rows() == 0 && reader.first_row() == 0 && !reader.data()); // no block yet
+    hsize_t rows = 0;
+    while (reader.next())
+    {
+      assert(reader.first_row() == rows);
+      for (hsize_t i = 0; i < reader.rows() * reader.get_row_size(); ++i)
+        assert(reader.data()[i] == field[rows * 50 + i]);
+      rows += reader.rows();
+    }
+    assert(rows == 100 && !reader.next());
+
+    h5::Properties plus_one(H5P_DATASET_XFER);
+    plus_one.data_transform("x+1");
+    h5::BlockReader<double> shifted(ds, 0, plus_one);
+    assert(shifted.next() && shifted.data()[0] == field[0] + 1.);
+
+    h5::BlockReader<double> chunked(root.open_group("testing_the_group").open_dataset("bigdata")); // blocks of one chunk
+    assert(chunked.next());
+    cout << chunked.get_num_blocks() << " blocks of " << chunked.get_block_rows() << " rows" << endl;
+
+    h5::BlockReader<bool> flags(root.open_dataset("bool_ds"), 2);
+    assert(flags.next() && flags.rows() == 2 && flags.data()[0] && !flags.data()[1]);
+    assert(flags.next() && flags.rows() == 1 && flags.data()[0] && !flags.next());
+  } // stops the reader before the end
+
+  cout << "-- attribute batches --" << endl;
+  {
+    h5::AttributeValues values;
+    root.open_group("attribute_batch_group").attrs().get_all(values);
+    assert(values.size() == 55 && values.contains("attr49"));
+    assert(values.get<int>("attr0") == 100 && values.get<double>("attr1") == 1.5 && values.get<double>("attr2") == 2.);
+    assert(values.get<string>("name") == "overwritten" && values.get<bool>("extra"));
+    vector<double> floats;
+    values.get_array("values", floats);
+    assert(floats.size() == 10 && floats[4] == 16.);
+    Particle p = values.get<Particle>("particle");
+    assert(p.y == 2. && p.id == 5);
+  }
+
+  cout << "-- group listings --" << endl;
+  {
+    h5::Group lg = root.open_group("listing_group");
+    vector<h5::LinkInfo> links = lg.list();
+    assert(links.size() == 4);
+    assert(links[0].name == "alpha" && links[0].is_group());
+    assert(links[1].name == "link_to_alpha" && links[1].link_type == H5L_TYPE_SOFT && links[1].object_type == H5O_TYPE_UNKNOWN);
+    assert(links[2].name == "mid" && links[2].is_dataset());
+    links = lg.list(false, H5_INDEX_CRT_ORDER);
+    assert(links[0].name == "zeta" && links[0].has_creation_order && links[3].creation_order == 3);
+    int ndatasets = 0;
+    lg.for_each_link([&ndatasets](const h5::LinkInfo &link) { ndatasets += link.is_dataset(); return ndatasets < 1; });
+    assert(ndatasets == 1); // stopped at the first dataset
+    assert(root.list().size() == root.size());
+  }
+
+  cout << "-- file catalogs --" << endl;
+  {
+    h5::Catalog catalog = h5::build_catalog(root);
+    assert(catalog.find(".")->is_group() && catalog.find(".")->num_attrs == root.attrs().size());
+    const h5::CatalogEntry *e = catalog.find("testing_the_group/bigdata");
+    assert(e && e->is_dataset() && e->get_npoints() == 10*20*30 && e->dims[2] == 30);
+    assert(e->type_class == H5T_FLOAT && e->type_size == 8 && e->layout == H5D_CHUNKED);
+    assert(std::find(e->filters.begin(), e->filters.end(), H5Z_FILTER_DEFLATE) != e->filters.end());
+    assert(catalog.find("mapped_ds")->layout == H5D_CONTIGUOUS && catalog.find("mapped_ds")->filters.empty());
+    cout << catalog.size() << " objects, " << catalog.datasets().size() << " datasets" << endl;
+
+    std::stringstream ss;
+    catalog.write(ss);
+    h5::Catalog cached = h5::Catalog::read(ss);
+    assert(cached.size() == catalog.size() && cached.matches(file));
+    assert(cached.find("testing_the_group/bigdata")->chunk_dims == e->chunk_dims);
+
+    const char *corrupt[] = { "h5cpp_catalog 1 0 0 1\nbad%zzpath 1 0 0 0 0 0 0 0\n", "h5cpp_catalog 1 0 0 1\npath% 1 0 0 0 0 0 0 0\n",
+                              "h5cpp_catalog 1 0 0 1\npath 1 0 0 0 0 99999999999999 0 0 0\n" };
+    for (int i = 0; i < 3; ++i)
+    {
+      std::stringstream bad(corrupt[i]);
+      bool failed = false;
+      try { h5::Catalog::read(bad); } catch (const h5::Exception &) { failed = true; }
+      assert(failed);
+    }
+  }
+
+  cout << "-- selections --" << endl;
+  {
+    ds = root.open_dataset("mapped_ds"); // 100 x 50, values 0.25*i
+    vector<double> values;
+    h5::Selection(ds).add({ h5::Slice(0, 10, 2), h5::Slice::all() }).read(ds, values); // even rows 0 .. 8
+    assert(values.size() == 5*50 && values[50] == 0.25 * 100);
+    h5::Selection(ds).add({ -1, h5::Slice(-3, h5::Slice::END) }).add({ 0, 0 }).read(ds, values); // a union, in file order
+    assert(values.size() == 4 && values[0] == 0. && values[1] == 0.25 * 4997 && values[3] == 0.25 * 4999);
+    h5::Selection(ds).add({ h5::Slice(0, 10), h5::Slice(0, 10) }).intersect({ h5::Slice(5, 20), h5::Slice(8, 9) }).read(ds, values);
+    assert(values.size() == 5 && values[0] == 0.25 * 258);
+    h5::Selection(ds).add({ h5::Slice(3, 3), 0 }).read(ds, values); // empty
+    assert(values.empty());
+    hsize_t points[] = { 99, 0,  1, 1,  2, 2 };
+    h5::Selection(ds).add_points(3, points).read(ds, values);
+    assert(values.size() == 3 && values[0] == 0.25 * 4950 && values[2] == 0.25 * 102);
+
+    vector<int> ints;
+    h5::read_dataset(root.open_dataset("selection_ds"), ints);
+    assert(ints[0] == 1 && ints[21] == 1 && ints[2] == 0 && ints[16*20 + 16] == 1 && std::accumulate(ints.begin(), ints.end(), 0) == 16);
+  }
+
+  cout << "-- blocks of arrays in memory --" << endl;
+  {
+    ds = root.open_dataset("ghost_domain_ds");
+    vector<float> interior;
+    h5::read_dataset(ds, interior);
+    assert(interior.size() == 20 && interior[7] == 12.f); // no ghost cells on disk
+
+    hsize_t extent[2] = { 8, 9 }, offset[2] = { 2, 2 }, count[2] = { 4, 5 };
+    vector<float> domain(8*9, -1.f);
+    ds.read(h5::ArrayBlock(2, extent, offset, count), &domain[0]); // two layers of ghost cells this time
+    assert(domain[2*9 + 2] == 0.f && domain[5*9 + 6] == 34.f && domain[5*9 + 7] == -1.f && domain[1*9 + 2] == -1.f);
+
+    hsize_t extent1 = 20, offset1 = 1, count1 = 10, stride1 = 2;
+    vector<float> odd(20, -1.f);
+    h5::Selection rows(ds);
+    rows.add({ h5::Slice(0, 2), h5::Slice::all() });
+    ds.read(h5::ArrayBlock(1, &extent1, &offset1, &count1, &stride1), rows.get_file_space(), &odd[0]); // rows 0 and 1 into odd elements
+    assert(odd[0] == -1.f && odd[1] == 0.f && odd[3] == 1.f && odd[19] == 14.f);
+
+    bool failed = false;
+    try
+    {
+      hsize_t transposed[2] = { 5, 4 };
+      ds.read(h5::ArrayBlock(2, extent, offset, transposed), &domain[0]);
+    }
+    catch (const h5::Exception &)
+    {
+      failed = true;
+    }
+    assert(failed);
+  }
+
+  cout << "-- error codes --" << endl;
+  {
+    std::error_code ec;
+    h5::Dataset missing = root.open_dataset("no_such_dataset", ec);
+    assert(ec == h5::ERROR_NOT_FOUND && !missing.is_valid());
+    h5::Group gmissing = root.open_group("no_such_group", ec);
+    assert(ec == h5::ERROR_NOT_FOUND && !gmissing.is_valid());
+    assert(!root.exists("no_such_group/child", ec) && ec == h5::ERROR_NOT_FOUND); // the library fails on the missing group
+    assert(!root.exists("/no_such_group/child/grandchild", ec) && ec == h5::ERROR_NOT_FOUND);
+    assert(root.exists("testing_the_group/bigdata", ec) && !ec);
+    assert(!root.exists("testing_the_group/no_such_dataset", ec) && !ec);
+    ds = root.open_dataset("no_such_group/child", ec);
+    assert(ec == h5::ERROR_NOT_FOUND && !ds.is_valid());
+    ds = root.open_dataset("dataset_from_list", ec);
+    assert(!ec && ds.is_valid());
+    vector<int> cubes(10);
+    ds.read(&cubes[0], ec);
+    assert(!ec && cubes[3] == 27);
+    h5::Properties plus_one(H5P_DATASET_XFER);
+    plus_one.data_transform("x+1");
+    ds.read(&cubes[0], plus_one, ec);
+    assert(!ec && cubes[3] == 28);
+    vector<string> strings(10);
+    ds.read(&strings[0], ec); // no conversion from integers to strings
+    assert(ec == h5::ERROR_LIBRARY && strings[0].empty());
+    ds.write(&cubes[0], ec); // the file is read only
+    assert(ec == h5::ERROR_LIBRARY);
+    root.attrs().set("new_attr", 1, ec);
+    assert(ec == h5::ERROR_LIBRARY);
+    assert(!root.attrs().exists("new_attr", ec) && !ec);
+    h5::Attribute attr = root.attrs().open("origin", ec);
+    assert(ec == h5::ERROR_NOT_FOUND);
+
+    try
+    {
+      root.open_dataset("no_such_dataset");
+    }
+    catch (const h5::Exception &e)
+    {
+      assert(e.get_message() == "unable to open dataset: no_such_dataset");
+      assert(string(e.what()).find("Error Stack: *") != string::npos); // formatted on demand
+    }
+  }
+
+  cout << "-- prepared I/O --" << endl;
+  {
+    ds = root.open_dataset("prepared_ds");
+    h5::Dataspace filesp = ds.get_dataspace();
+    hsize_t offset[2] = { 0, 0 }, count[2] = { 10, 10 };
+    filesp.select_hyperslab(offset, NULL, count, NULL);
+    h5::Dataspace memsp = h5::Dataspace::simple_dims(100);
+    h5::ReadPlan<int> plan = ds.prepare_read<int>(memsp, filesp);
+    memsp.select_none(); // the plan keeps its own copies of the dataspaces
+    filesp.select_none();
+    vector<int> block(100);
+    for (int i = 0; i < 1000; i += 10)
+    {
+      hssize_t shift[2] = { i, 0 };
+      plan.execute_at(shift, &block[0]);
+      assert(block[0] == 10 * i && block[99] == 10 * i + 99);
+    }
+  }
+
+  cout << "-- transfer properties --" << endl;
+  {
+    ds = root.open_dataset("converted_ds");
+    vector<double> converted;
+    h5::read_dataset(ds, converted); // int to double in passes of the default conversion buffer
+    assert(converted.size() == (1<<19) && converted[12345] == 12345. && converted.back() == (1<<19) - 1);
+    h5::Properties xfer(H5P_DATASET_XFER);
+    xfer.conversion_buffer(4096).edc_check(false);
+    h5::read_dataset(ds, converted, xfer);
+    assert(converted[54321] == 54321.);
+    vector<int> transformed(100);
+    root.open_dataset("transformed_ds").read(&transformed[0]);
+    assert(transformed[0] == 1 && transformed[99] == 100);
+    h5::Properties doubled(H5P_DATASET_XFER);
+    doubled.data_transform("2*x");
+    root.open_dataset("transformed_ds").read(&transformed[0], doubled);
+    assert(transformed[0] == 2 && transformed[99] == 200);
+  }
+
+  cout << "-- byte order of disk types --" << endl;
+  {
+    vector<double> values;
+    ds = root.open_dataset("big_endian_ds");
+    assert(H5Tget_order(ds.get_datatype().get_id()) == H5T_ORDER_BE);
+    h5::read_dataset(ds, values);
+    assert(values[0] == 0.5 && values[99] == 99.5);
+    ds = root.open_dataset("native_order_ds");
+    assert(ds.get_datatype().is_equal(h5::get_memtype<double>())); // no conversion
+    h5::read_dataset(ds, values);
+    assert(values[99] == 99.5);
+    vector<Particle> particles;
+    h5::read_dataset(root.open_dataset("big_endian_particles"), particles);
+    assert(particles[9].z == 27. && particles[9].m == 4.5f && particles[9].id == 9);
+    assert(h5::get_memtype<bool>().is_equal(h5::get_disktype<bool>()) == (H5Tget_order(H5T_NATIVE_INT) == H5T_ORDER_LE));
+    bool flags[3];
+    root.open_dataset("bool_ds").read(flags);
+    assert(flags[0] && !flags[1] && flags[2]);
+  }
+
+  cout << "-- filters --" << endl;
+  {
+    ds = root.open_dataset("shuffled_ds");
+    h5::Properties dcpl = ds.get_creation_properties();
+    assert(dcpl.get_nfilters() == 3 && dcpl.get_filter(0) == H5Z_FILTER_SHUFFLE && dcpl.get_filter(2) == H5Z_FILTER_FLETCHER32);
+    vector<float> field;
+    h5::read_dataset(ds, field);
+    assert(field.size() == 10000 && field[5000] == std::sin(0.01f * 5000));
+    vector<int> values;
+    h5::read_dataset(root.open_dataset("scaleoffset_ds"), values);
+    assert(values[0] == 1000 && values[999] == 1999);
+    ds = root.open_dataset("xor_ds");
+    unsigned int cd_values[1];
+    size_t cd_nelmts = 1;
+    assert(ds.get_creation_properties().get_filter(0, NULL, &cd_nelmts, cd_values) == XOR_FILTER && cd_values[0] == 0x5a);
+    h5::read_dataset(ds, values); // the filter is still registered
+    assert(values[0] == 1000 && values[999] == 1999);
+  }
+
+  cout << "-- block decomposition --" << endl;
+  {
+    vector<int> values;
+    h5::read_dataset(root.open_dataset("decomposed_ds"), values);
+    for (int i = 0; i < 70; ++i)
+      assert(values[i] == i);
+    h5::read_dataset(root.open_dataset("decomposed_few_ds"), values);
+    assert(values.size() == 3 && values[0] == 0 && values[2] == 2);
+  }
 }
 #endif
 
@@ -283,6 +1192,7 @@ void ReadFile()
 int main(int argc, char **argv)
 {
   h5::disableAutoErrorReporting();  // don't print to stderr
+  h5::init_type_registry();
   WriteFile();
   ReadFile();
   cin.get();
@@ -0,0 +1,99 @@
+/*
+  Test of parallel file access with MPI-IO. Requires HDF5 built with MPI support.
+  Run with e.g. mpirun -np 4 ./hdf_wrapper_mpi_test
+*/
+#include <iostream>
+#include <vector>
+#include <cassert>
+
+#include <mpi.h>
+#include "hdf_wrapper.h"
+
+using namespace std;
+namespace h5 = h5cpp;
+
+
+// the value of element (y, x) of the global array
+double GlobalValue(hsize_t y, hsize_t x)
+{
+  return 1000. * y + x;
+}
+
+
+void WriteBlocks(int nprocs, int proc)
+{
+  if (proc == 0) cout << "-- collective writes of blocks --" << endl;
+  h5::File file = h5::File::parallel("test_mpi.h5", "w", MPI_COMM_WORLD);
+  hsize_t global[2] = { 101, 37 }; // not divisible by the process grid
+  h5::BlockDecomposition block(2, global, nprocs, proc);
+  vector<double> local(block.get_npoints());
+  for (hsize_t y = 0, i = 0; y < block.get_count()[0]; ++y)
+    for (hsize_t x = 0; x < block.get_count()[1]; ++x, ++i)
+      local[i] = GlobalValue(block.get_offset()[0] + y, block.get_offset()[1] + x);
+
+  h5::Properties collective(H5P_DATASET_XFER);
+  collective.mpio_transfer(H5FD_MPIO_COLLECTIVE);
+  const char* names[2] = { "contiguous", "chunked" };
+  for (int k = 0; k < 2; ++k)
+  {
+    // creation is collective, too
+    h5::Dataset ds = h5::Dataset::create<double>(file.root(), names[k], h5::Dataspace::simple(2, global), k == 0 ? h5::CREATE_DS_0 : h5::CREATE_DS_CHUNKED);
+    h5::Dataspace filesp = ds.get_dataspace();
+    block.select(filesp);
+    ds.write(block.get_mem_space(), filesp, local.empty() ? NULL : &local[0], collective);
+  }
+
+  // one element per process, independently
+  hsize_t n = nprocs;
+  h5::Dataset ds = h5::Dataset::create<int>(file.root(), "ranks", h5::Dataspace::simple(1, &n), h5::CREATE_DS_0);
+  h5::Properties independent(H5P_DATASET_XFER);
+  independent.mpio_transfer(H5FD_MPIO_INDEPENDENT);
+  h5::Selection sel(ds);
+  sel.set({ h5::Slice(proc) });
+  sel.write(ds, &proc, independent);
+}
+
+
+void ReadBlocks(int nprocs, int proc)
+{
+  if (proc == 0) cout << "-- collective reads of blocks --" << endl;
+  h5::File file = h5::File::parallel("test_mpi.h5", "r", MPI_COMM_WORLD);
+  h5::Properties collective(H5P_DATASET_XFER);
+  collective.mpio_transfer(H5FD_MPIO_COLLECTIVE);
+  const char* names[2] = { "contiguous", "chunked" };
+  for (int k = 0; k < 2; ++k)
+  {
+    h5::Dataset ds = file.root().open_dataset(names[k]);
+    hsize_t global[2];
+    ds.get_dataspace().get_dims(global);
+    // the block of the next process, so that no process reads what it wrote
+    h5::BlockDecomposition block(2, global, nprocs, (proc + 1) % nprocs);
+    vector<double> local(block.get_npoints());
+    h5::Dataspace filesp = ds.get_dataspace();
+    block.select(filesp);
+    ds.read(block.get_mem_space(), filesp, local.empty() ? NULL : &local[0], collective);
+    for (hsize_t y = 0, i = 0; y < block.get_count()[0]; ++y)
+      for (hsize_t x = 0; x < block.get_count()[1]; ++x, ++i)
+        assert(local[i] == GlobalValue(block.get_offset()[0] + y, block.get_offset()[1] + x));
+  }
+
+  vector<int> ranks;
+  h5::read_dataset(file.root().open_dataset("ranks"), ranks); // independent, by default
+  assert(ranks.size() == size_t(nprocs));
+  for (int i = 0; i < nprocs; ++i)
+    assert(ranks[i] == i);
+}
+
+
+int main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+  int nprocs, proc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &proc);
+  WriteBlocks(nprocs, proc);
+  ReadBlocks(nprocs, proc);
+  if (proc == 0) cout << "passed on " << nprocs << " processes" << endl;
+  MPI_Finalize();
+  return 0;
+}